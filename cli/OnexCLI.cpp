@@ -1,9 +1,11 @@
 #include <chrono>
+#include <cctype>
 #include <cstring>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
 #include <map>
+#include <sstream>
 #include <vector>
 #include <cmath>
 #include <boost/tokenizer.hpp>
@@ -52,6 +54,43 @@ bool tooManyArgs(const vector<string>& args, int limit)
   return false;
 }
 
+string formatBytes(size_t bytes)
+{
+  const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+  double value = bytes;
+  int unit = 0;
+  while (value >= 1024 && unit < 4) {
+    value /= 1024;
+    unit++;
+  }
+  ostringstream out;
+  out << fixed << setprecision(unit == 0 ? 0 : 1) << value << " " << units[unit];
+  return out.str();
+}
+
+string formatPercent(uint64_t part, uint64_t whole)
+{
+  ostringstream out;
+  out << fixed << setprecision(1) << (whole > 0 ? 100.0 * part / whole : 0.0) << "%";
+  return out.str();
+}
+
+// Average time in seconds to match the middle half of up to 10 time series
+// of a grouped dataset against itself
+double timeSampleQueries(int index)
+{
+  onex::dataset_info_t info = gOnexAPI.getDatasetInfo(index);
+  int queryCount = min(10, info.itemCount);
+  chrono::time_point<chrono::system_clock> start = chrono::system_clock::now();
+  for (int i = 0; i < queryCount; i++)
+  {
+    int ts = i * info.itemCount / queryCount;
+    gOnexAPI.getBestMatch(index, index, ts, info.itemLength / 4, info.itemLength * 3 / 4);
+  }
+  chrono::duration<double> elapsed = chrono::system_clock::now() - start;
+  return queryCount > 0 ? elapsed.count() / queryCount : 0;
+}
+
 /**************************************************************************
  * HOW TO CREATE A NEW COMMAND
  *
@@ -74,7 +113,7 @@ bool tooManyArgs(const vector<string>& args, int limit)
 
 MAKE_COMMAND(LoadDataset,
   {
-    if (tooFewArgs(args, 2) || tooManyArgs(args, 5))
+    if (tooFewArgs(args, 2) || tooManyArgs(args, 6))
     {
       return false;
     }
@@ -83,10 +122,11 @@ MAKE_COMMAND(LoadDataset,
     int maxNumRow = args.size() > 2 ? stoi(args[2]) : 0;
     int startCol  = args.size() > 3 ? stoi(args[3]) : 0;
     string separators = args.size() > 4 ? args[4] : " ";
+    int numThreads = args.size() > 5 ? stoi(args[5]) : 1;
 
     onex::dataset_info_t info;
     
-    info = gOnexAPI.loadDataset(filePath, maxNumRow, startCol, separators);
+    info = gOnexAPI.loadDataset(filePath, maxNumRow, startCol, separators, numThreads);
 
     cout << "Dataset loaded                         " << endl
               << "  Name:        " << info.name       << endl
@@ -100,9 +140,10 @@ MAKE_COMMAND(LoadDataset,
   "Load a dataset to the memory",
 
   "Dataset are text files with table-like format, such as comma-separated  \n"
-  "values files.                                                           \n"
+  "values files. Binary files written by 'save ... binary' and NumPy .npy  \n"
+  "files are also accepted; for them only maxNumRow is used.               \n"
   "                                                                        \n"
-  "Usage: load <filePath> [<maxNumRow> <startCol> <separators>]            \n"
+  "Usage: load <filePath> [<maxNumRow> <startCol> <separators> <threads>]  \n"
   "  filePath  - Path to a text file containing the dataset                \n"
   "  maxNumRow - Maximum number of rows will be read from the file. If this\n"
   "              number is non-positive or the number of actual line is    \n"
@@ -110,6 +151,9 @@ MAKE_COMMAND(LoadDataset,
   "  startCol  - Omit all columns before this column. (default: 0)         \n"
   "  separators - A list of characters used to separate values in the file \n"
   "              (default: <space>)                                        \n"
+  "  threads   - Number of threads used to parse the file. If this number  \n"
+  "              is non-positive, all hardware threads are used.          \n"
+  "              (default: 1)                                              \n"
   )
 
 MAKE_COMMAND(SaveDataset,
@@ -121,9 +165,16 @@ MAKE_COMMAND(SaveDataset,
 
     int index = stoi(args[1]);
     string filePath = args[2];
-    char separator = args.size() == 4 && args[3][0] != '\n' ? args[3][0] : ' ';
-  
-    gOnexAPI.saveDataset(index, filePath, separator);
+
+    if (args.size() == 4 && args[3] == "binary")
+    {
+      gOnexAPI.saveDatasetBinary(index, filePath);
+    }
+    else
+    {
+      char separator = args.size() == 4 && args[3][0] != '\n' ? args[3][0] : ' ';
+      gOnexAPI.saveDataset(index, filePath, separator);
+    }
 
     cout << "Saved dataset " << index << " to " << filePath << endl;
 
@@ -132,11 +183,13 @@ MAKE_COMMAND(SaveDataset,
 
   "Save a dataset from memory to disk",
 
-  "Usage: save <dataset_index> <filePath> [<separator>]            \n"
+  "Usage: save <dataset_index> <filePath> [<separator>|binary]     \n"
   "  dataset_index - Index of the dataset to be saved              \n"
   "  filePath  - Path to the saved file                            \n"
   "  separator - Separator between values in a series              \n"
   "              (default: <space>)                                \n"
+  "  binary    - Save in the binary format instead. Binary files   \n"
+  "              are loaded instantly with 'load'                  \n"
   )
 
 MAKE_COMMAND(UnloadDataset,
@@ -240,17 +293,87 @@ MAKE_COMMAND(Timer,
 
 MAKE_COMMAND(GroupDataset,
   {
-    if (tooFewArgs(args, 3) || tooManyArgs(args, 3))
+    if (tooFewArgs(args, 3))
     {
       return false;
     }
 
     int index = stoi(args[1]);
+    if (args[2] == "auto")
+    {
+      if (tooFewArgs(args, 5) || tooManyArgs(args, 6))
+      {
+        return false;
+      }
+      int maxGroupCount = 0;
+      size_t maxMemoryUsage = 0;
+      if (args[3] == "groups") {
+        maxGroupCount = stoi(args[4]);
+      }
+      else if (args[3] == "memory") {
+        maxMemoryUsage = stoull(args[4]) << 20;
+      }
+      else
+      {
+        cout << "Error! Unknown budget: " << args[3] << endl;
+        return false;
+      }
+      bool dropSingletons = args.size() > 5 ? stoi(args[5]) : false;
+
+      onex::auto_group_result_t result;
+      TIME_COMMAND(
+        result = gOnexAPI.groupDatasetWithBudget(index, maxGroupCount, maxMemoryUsage, dropSingletons);
+      )
+
+      cout << "Dataset " << index << " is now grouped" << endl;
+      cout << "Threshold: " << result.predicted.threshold << endl;
+      cout << "Number of Groups: " << result.groupCount
+           << " (predicted " << result.predicted.groupCount << ")" << endl;
+      cout << "Memory of Groups: " << formatBytes(result.memoryUsage)
+           << " (predicted " << formatBytes(result.predicted.memoryUsage) << ")" << endl;
+      if (result.droppedGroupCount > 0) {
+        cout << "Dropped " << result.droppedGroupCount << " singleton groups" << endl;
+      }
+      return true;
+    }
+
     onex::data_t threshold = stod(args[2]);
+    int numThreads = 1;
+    unsigned int next = 3;
+    if (args.size() > 3 && !isalpha(args[3][0]))
+    {
+      numThreads = stoi(args[3]);
+      next = 4;
+    }
+    if (tooManyArgs(args, next + 2))
+    {
+      return false;
+    }
+
+    onex::group_order_t order = onex::GROUP_ORDER_START;
+    string orderName = args.size() > next ? args[next] : "start";
+    if (orderName == "mean") {
+      order = onex::GROUP_ORDER_MEAN;
+    }
+    else if (orderName == "paa") {
+      order = onex::GROUP_ORDER_PAA;
+    }
+    else if (orderName != "start")
+    {
+      cout << "Error! Unknown order: " << orderName << endl;
+      return false;
+    }
+
+    string centroidName = args.size() > next + 1 ? args[next + 1] : "first";
+    if (centroidName != "first" && centroidName != "average")
+    {
+      cout << "Error! Unknown centroid: " << centroidName << endl;
+      return false;
+    }
 
     int count = -1;
     TIME_COMMAND(
-      count = gOnexAPI.groupDataset(index, threshold);
+      count = gOnexAPI.groupDataset(index, threshold, numThreads, order, centroidName == "average");
     )
 
     cout << "Dataset " << index << " is now grouped" << endl;
@@ -260,24 +383,96 @@ MAKE_COMMAND(GroupDataset,
 
   "Group a dataset in memory",
 
-  "Usage: group <dataset_index> <threshold>                       \n"
+  "Usage: group <dataset_index> <threshold> [<threads>] [<order> [<centroid>]]\n"
+  "       group <dataset_index> auto groups|memory <budget> [<dropSingletons>]\n"
   "  dataset_index   - Index of the dataset being grouped. Use    \n"
   "                    'list dataset' to retrieve the list of     \n"
   "                    loaded datasets.                           \n"
   "  threshold       - Threshold for grouping.                    \n"
+  "  threads         - Number of threads. With more than one, a   \n"
+  "                    sample is grouped first and the rest is    \n"
+  "                    assigned to its groups in parallel. If this\n"
+  "                    is non-positive, all hardware threads are  \n"
+  "                    used. (default: 1)                         \n"
+  "  order           - Order in which a single thread groups the  \n"
+  "                    sub-sequences of each length: 'start'      \n"
+  "                    goes by start position, 'mean' and 'paa'   \n"
+  "                    sort them by their mean or PAA word so that\n"
+  "                    similar ones are grouped together, which   \n"
+  "                    gives fewer groups. (default: start)       \n"
+  "  centroid        - 'first' keeps the first member of a group  \n"
+  "                    as its centroid. 'average' uses the mean of\n"
+  "                    the members, which gives fewer and tighter \n"
+  "                    groups. Only used with one thread.         \n"
+  "                    (default: first)                           \n"
+  "  auto            - Choose the smallest threshold whose groups \n"
+  "                    are predicted to fit in a budget, from a   \n"
+  "                    sample of the dataset.                     \n"
+  "  budget          - Maximum number of groups, or maximum memory\n"
+  "                    of the groups in MB.                       \n"
+  "  dropSingletons  - If set to 1 and the groups exceed the      \n"
+  "                    budget, groups with a single member are    \n"
+  "                    removed. (default: 0)                      \n"
+  )
+
+MAKE_COMMAND(RefineGroups,
+  {
+    if (tooFewArgs(args, 2) || tooManyArgs(args, 5))
+    {
+      return false;
+    }
+
+    int index = stoi(args[1]);
+    int iterations = args.size() > 2 ? stoi(args[2]) : 5;
+    int minGroupSize = args.size() > 3 ? stoi(args[3]) : 2;
+    int numThreads = args.size() > 4 ? stoi(args[4]) : 1;
+
+    double latencyBefore = timeSampleQueries(index);
+    onex::refine_result_t result;
+    TIME_COMMAND(
+      result = gOnexAPI.refineGroups(index, iterations, minGroupSize, numThreads);
+    )
+    double latencyAfter = timeSampleQueries(index);
+
+    cout << "Groups of dataset " << index << " are refined" << endl;
+    cout << "Number of Groups: " << result.groupCountBefore << " -> " << result.groupCount << endl;
+    cout << "Memory of Groups: " << formatBytes(result.memoryUsageBefore) << " -> "
+         << formatBytes(result.memoryUsage) << endl;
+    cout << "Query latency:    " << setprecision(4) << latencyBefore * 1000 << " ms -> "
+         << latencyAfter * 1000 << " ms" << endl;
+    return true;
+  },
+
+  "Refine the groups of a grouped dataset",
+
+  "Runs a few k-means-style iterations on the groups of each length. Each  \n"
+  "iteration moves every sub-sequence to its closest centroid, merges the  \n"
+  "groups smaller than a size floor into others, and replaces centroids by \n"
+  "the mean of their members, as long as every member stays within half of \n"
+  "the threshold. The latency of sample queries is measured before and     \n"
+  "after.                                                                  \n"
+  "                                                                        \n"
+  "Usage: refine <dataset_index> [<iterations> [<minGroupSize> [<threads>]]]\n"
+  "  dataset_index   - Index of the grouped dataset.                       \n"
+  "  iterations      - Maximum number of iterations. (default: 5)          \n"
+  "  minGroupSize    - Groups with fewer members are merged into others    \n"
+  "                    when possible. (default: 2)                         \n"
+  "  threads         - Number of threads. If this is non-positive, all     \n"
+  "                    hardware threads are used. (default: 1)             \n"
   )
 
 MAKE_COMMAND(SaveGroup,
   {
-    if (tooFewArgs(args, 3) || tooManyArgs(args, 4))
+    if (tooFewArgs(args, 3) || tooManyArgs(args, 5))
     {
       return false;
     }
 
     int index = stoi(args[1]);
-    bool groupSizeOnly = args.size() == 4 ? stoi(args[3]) : false;
+    bool groupSizeOnly = args.size() > 3 ? stoi(args[3]) : false;
+    int version = args.size() > 4 ? stoi(args[4]) : GROUP_FILE_VERSION;
 
-    gOnexAPI.saveGroup(index, args[2], groupSizeOnly);
+    gOnexAPI.saveGroup(index, args[2], groupSizeOnly, version);
     cout << "Saved groups of dataset " << index << " to " << args[2] << endl;
 
     return true;
@@ -285,21 +480,27 @@ MAKE_COMMAND(SaveGroup,
 
   "Save groups of a grouped dataset",
 
-  "Usage: saveGroup <dataset_index> <path> [<groupSizeOnly>]            \n"
+  "Usage: saveGroup <dataset_index> <path> [<groupSizeOnly> <version>]  \n"
   "  dataset_index   - Index of the dataset whose groups will be saved. \n"
   "  path            - Where to save the groups.                        \n"
   "  groupSizeOnly   - If set to 1, only the sizes of groups are saved  \n"
   "                    Default is 0.                                    \n"
+  "  version         - File format version: 1 for text, 2 for binary.   \n"
+  "                    Group sizes are always saved as text.            \n"
+  "                    Default is 2.                                    \n"
   )
 
 MAKE_COMMAND(LoadGroup,
   {
-    if (tooFewArgs(args, 3) || tooManyArgs(args, 3))
+    if (tooFewArgs(args, 3) || tooManyArgs(args, 4))
     {
       return false;
     }
 
     int index = stoi(args[1]);
+    if (args.size() > 3) {
+      gOnexAPI.setGroupMemoryLimit(index, stoull(args[3]) << 20);
+    }
 
     int numGroups = gOnexAPI.loadGroup(index, args[2]);
     cout << numGroups << " groups loaded for dataset " << index;
@@ -310,11 +511,19 @@ MAKE_COMMAND(LoadGroup,
   "Load saved groups to a compatible dataset",
 
   "A dataset is compatible with a saved group file is when the item      \n"
-  "count and item length is the same.                                    \n"
+  "count and item length is the same. Both text (version 1) and binary   \n"
+  "(version 2) group files can be loaded.                                \n"
+  "                                                                      \n"
+  "Groups in a binary file are read from it when a query first needs     \n"
+  "them.                                                                 \n"
   "                                                                      \n"
-  "Usage: loadGroup <dataset_index> <path>                               \n"
+  "Usage: loadGroup <dataset_index> <path> [<memoryLimit>]               \n"
   "  dataset_index   - Index of the dataset whose groups will be loaded. \n"
   "  path            - Where to save the groups.                         \n"
+  "  memoryLimit     - Maximum memory in MB used by groups read from a   \n"
+  "                    binary file. Lengths used least recently are     \n"
+  "                    dropped and read again when needed. 0 means no    \n"
+  "                    limit. (default: 0)                               \n"
   )
 
 MAKE_COMMAND(NormalizeDataset,
@@ -369,7 +578,7 @@ MAKE_COMMAND(PAA,
 
 MAKE_COMMAND(Match,
   {
-    if (tooFewArgs(args, 4) || tooManyArgs(args, 6))
+    if (tooFewArgs(args, 4) || tooManyArgs(args, 10))
     {
       return false;
     }
@@ -379,17 +588,78 @@ MAKE_COMMAND(Match,
     int ts_index = stoi(args[3]);
     int start = -1;
     int end = -1;
+    unsigned int next = 4;
 
-    if (args.size() > 4)
+    if (args.size() > 4 && isdigit(args[4][0]))
     {
+      if (tooFewArgs(args, 6))
+      {
+        return false;
+      }
       start = stoi(args[4]);
       end = stoi(args[5]);
+      next = 6;
     }
 
-    TIME_COMMAND(
-      onex::candidate_time_series_t best =
-        gOnexAPI.getBestMatch(db_index, q_index, ts_index, start, end);
-    )
+    string mode = args.size() > next ? args[next] : "group";
+    unsigned int modeArgs = mode == "approx" ? 4 : (mode == "timed" ? 2 : 1);
+    if (tooManyArgs(args, next + modeArgs))
+    {
+      return false;
+    }
+    onex::candidate_time_series_t best;
+
+    if (mode == "group")
+    {
+      TIME_COMMAND(
+        best = gOnexAPI.getBestMatch(db_index, q_index, ts_index, start, end);
+      )
+    }
+    else if (mode == "euclidean")
+    {
+      TIME_COMMAND(
+        best = gOnexAPI.getBestMatchEuclidean(db_index, q_index, ts_index, start, end);
+      )
+    }
+    else if (mode == "approx" || mode == "timed" || mode == "wide")
+    {
+      if (mode != "wide" && tooFewArgs(args, next + 2))
+      {
+        return false;
+      }
+      onex::match_options_t options;
+      if (mode == "wide")
+      {
+        options.allLengths = true;
+      }
+      else if (mode == "approx")
+      {
+        options.epsilon = stod(args[next + 1]);
+        options.maxGroups = args.size() > next + 2 ? stoi(args[next + 2]) : 0;
+        options.maxLengths = args.size() > next + 3 ? stoi(args[next + 3]) : 0;
+      }
+      else {
+        options.timeBudget = stod(args[next + 1]);
+      }
+      onex::match_result_t result;
+      TIME_COMMAND(
+        result = gOnexAPI.getApproximateMatch(db_index, q_index, options, ts_index, start, end);
+      )
+      best = result.match;
+      cout << "Searched " << result.lengthsVisited << " of " << result.lengthCount << " lengths and "
+           << result.groupsVisited << " groups" << (result.complete ? "" : ", stopped early") << endl;
+    }
+    else if (mode == "mass")
+    {
+      TIME_COMMAND(
+        best = gOnexAPI.getBestMatchBruteForce(db_index, q_index, ts_index, start, end);
+      )
+    }
+    else
+    {
+      cout << "Error! Unknown match mode: " << mode << endl;
+      return false;
+    }
 
     cout << "Best Match is timeseries " << best.data.getIndex()
     << " starting at " << best.data.getStart()
@@ -402,7 +672,10 @@ MAKE_COMMAND(Match,
 
   "Find the best match of a time series",
 
-  "Usage: match <target_dataset_idx> <q_dataset_idx> <ts_index> [<start> <end>]                    \n"
+  "Usage: match <target_dataset_idx> <q_dataset_idx> <ts_index> [<start> <end>] [<mode>]          \n"
+  "       match <target_dataset_idx> <q_dataset_idx> <ts_index> [<start> <end>] approx <epsilon>   \n"
+  "             [<max_groups> [<max_lengths>]]                                                     \n"
+  "       match <target_dataset_idx> <q_dataset_idx> <ts_index> [<start> <end>] timed <seconds>    \n"
   "  dataset_index   - Index of loaded dataset to get the result from.                             \n"
   "                    Use 'list dataset' to retrieve the list of                                  \n"
   "                    loaded datasets.                                                            \n"
@@ -410,6 +683,128 @@ MAKE_COMMAND(Match,
   "  ts_index        - Index of the query                                                          \n"
   "  start           - The start location of the query in the timeseries                           \n"
   "  end             - The end location of the query in the timeseries (this point is not included)\n"
+  "  mode            - 'group' searches the grouped dataset using DTW across lengths.              \n"
+  "                    'euclidean' finds the exact closest sub-sequence of the query's length by  \n"
+  "                    Euclidean distance, pruning groups and members with their distances to    \n"
+  "                    the centroids. 'mass' does not need groups and scans every sub-sequence of \n"
+  "                    the query's length using FFT-based distance profiles. 'wide' searches as   \n"
+  "                    'group' but compares the members of the best group at every length from   \n"
+  "                    their start. (default: group)                                              \n"
+  "  epsilon         - 'approx' searches as 'group' but stops at the first centroid within epsilon \n"
+  "                    of the query. It bounds the distance to the centroid, so the match itself  \n"
+  "                    may be farther                                                              \n"
+  "  max_groups      - 'approx' stops after comparing this many centroids. 0 means no limit        \n"
+  "                    (default: 0)                                                                \n"
+  "  max_lengths     - 'approx' stops after searching this many lengths. 0 means no limit          \n"
+  "                    (default: 0)                                                                \n"
+  "  seconds         - 'timed' searches as 'group' but returns the best match found so far once    \n"
+  "                    this time has passed                                                        \n"
+  )
+
+MAKE_COMMAND(Stats,
+  {
+    if (tooFewArgs(args, 2))
+    {
+      return false;
+    }
+
+    if (args[1] == "memory")
+    {
+      if (tooManyArgs(args, 3))
+      {
+        return false;
+      }
+      vector<onex::dataset_info_t> infos;
+      if (args.size() > 2) {
+        infos.push_back(gOnexAPI.getDatasetInfo(stoi(args[2])));
+      }
+      else {
+        infos = gOnexAPI.getAllDatasetInfo();
+      }
+
+      for (const auto& info : infos)
+      {
+        onex::memory_usage_t usage = gOnexAPI.getMemoryUsage(info.id);
+        cout << "Dataset " << info.id << " " << info.name << endl
+             << "  Values:          " << formatBytes(usage.dataset) << endl
+             << "  Groups:          " << formatBytes(usage.groups) << endl
+             << "  Keogh envelopes: " << formatBytes(usage.keoghCache) << " (part of groups)" << endl
+             << "  Mapped files:    " << formatBytes(usage.mapped) << endl;
+        for (unsigned int length = 0; length < usage.lengths.size(); length++)
+        {
+          if (usage.lengths[length] > 0) {
+            cout << "    Length " << setw(6) << length << ": " << formatBytes(usage.lengths[length]) << endl;
+          }
+        }
+      }
+      cout << "Total allocated: " << formatBytes(gOnexAPI.getTotalMemoryUsage()) << endl;
+    }
+    else if (args[1] == "estimate")
+    {
+      if (tooFewArgs(args, 4) || tooManyArgs(args, 5))
+      {
+        return false;
+      }
+      int index = stoi(args[2]);
+      onex::data_t threshold = stod(args[3]);
+      int sampleLengths = args.size() > 4 ? stoi(args[4]) : 8;
+
+      onex::group_estimate_t estimate;
+      TIME_COMMAND(
+        estimate = gOnexAPI.estimateGroupDataset(index, threshold, sampleLengths);
+      )
+      cout << "Estimated number of groups: " << estimate.groupCount << endl
+           << "Estimated memory of groups: " << formatBytes(estimate.memoryUsage) << endl
+           << "Estimated peak while grouping: " << formatBytes(estimate.peakMemoryUsage) << endl;
+    }
+    else if (args[1] == "cascade")
+    {
+      if (tooManyArgs(args, 3))
+      {
+        return false;
+      }
+      bool reset = args.size() > 2;
+      if (reset && args[2] != "reset")
+      {
+        cout << "Error! Unknown option: " << args[2] << endl;
+        return false;
+      }
+      onex::cascade_stats_t stats = gOnexAPI.getCascadeStats();
+      uint64_t keoghSurvivors = stats.candidates - stats.keoghPruned;
+      cout << "Pairs compared:          " << stats.candidates << endl
+           << "  Pruned by LB_Keogh:    " << stats.keoghPruned
+           << " (" << formatPercent(stats.keoghPruned, stats.candidates) << " of pairs)" << endl
+           << "  Pruned by LB_Improved: " << stats.improvedPruned
+           << " (" << formatPercent(stats.improvedPruned, keoghSurvivors) << " of the rest)" << endl
+           << "  Warped distances:      " << stats.warped << endl;
+      if (reset) {
+        gOnexAPI.resetCascadeStats();
+      }
+    }
+    else
+    {
+      cout << "Error! Unknown statistics: " << args[1] << endl;
+      return false;
+    }
+    return true;
+  },
+
+  "Show memory and search statistics",
+
+  "Usage: stats memory [<dataset_index>]                                 \n"
+  "  Shows the memory used by each dataset and its groups, with the      \n"
+  "  groups broken down by length. If dataset_index is not given, all    \n"
+  "  loaded datasets are shown.                                          \n"
+  "                                                                      \n"
+  "Usage: stats estimate <dataset_index> <threshold> [<sampleLengths>]   \n"
+  "  Predicts the number of groups and their memory if the dataset were  \n"
+  "  grouped with the threshold. Only sampleLengths lengths are grouped  \n"
+  "  and the others are interpolated. (default: 8)                       \n"
+  "                                                                      \n"
+  "Usage: stats cascade [reset]                                          \n"
+  "  Shows how many pairs each lower bound of the DTW cascade pruned      \n"
+  "  before a warped distance was computed. With 'reset', the counts are \n"
+  "  set back to 0 after being shown.                                    \n"
   )
 
 /**************************************************************************
@@ -426,11 +821,13 @@ map<string, Command*> commands = {
   {"list", &cmdList},
   {"timer", &cmdTimer},
   {"group", &cmdGroupDataset},
+  {"refine", &cmdRefineGroups},
   {"saveGroup", &cmdSaveGroup},
   {"loadGroup", &cmdLoadGroup},  
   {"normalize", &cmdNormalizeDataset},
   {"paa", &cmdPAA},
-  {"match", &cmdMatch}
+  {"match", &cmdMatch},
+  {"stats", &cmdStats}
 };
 
 /**************************************************************************/
@@ -0,0 +1,81 @@
+#ifndef BINARY_FILE_H
+#define BINARY_FILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+#include "Exception.hpp"
+#include "MappedFile.hpp"
+#include "TimeSeries.hpp"
+
+namespace onex {
+
+/**
+ *  @brief rounds an offset in a binary file up to a multiple of 8 bytes
+ */
+inline uint64_t alignOffset(uint64_t offset)
+{
+  return (offset + 7) & ~(uint64_t)7;
+}
+
+/**
+ *  @brief writes zeros until the position of a stream is a multiple of 8 bytes
+ */
+inline void writePadding(std::ostream& out)
+{
+  static const char zeros[8] = {};
+  uint64_t pos = (uint64_t)out.tellp();
+  out.write(zeros, alignOffset(pos) - pos);
+}
+
+/**
+ *  @brief gets count items of type T stored at an offset of a mapped file
+ *
+ *  @throw OnexException if the items do not fit in the file
+ */
+template <typename T>
+const T* getSection(const MappedFile& file, uint64_t offset, uint64_t count)
+{
+  if (offset > file.getSize() || (file.getSize() - offset) / sizeof(T) < count)
+  {
+    throw OnexException("File is shorter than its header says");
+  }
+  return (const T*)(file.getData() + offset);
+}
+
+template <typename T>
+void convertValues(const char* source, data_t* dest, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    T value;
+    memcpy(&value, source + i * sizeof(T), sizeof(T));
+    dest[i] = (data_t)value;
+  }
+}
+
+/**
+ *  @brief reads values stored as floats or doubles into data_t
+ *
+ *  @param source the stored values
+ *  @param valueSize size of a stored value: sizeof(float) or sizeof(double)
+ *  @param dest where the values are written
+ *  @param count number of values
+ */
+inline void readValues(const char* source, int valueSize, data_t* dest, size_t count)
+{
+  if (valueSize == sizeof(data_t)) {
+    memcpy(dest, source, count * sizeof(data_t));
+  }
+  else if (valueSize == sizeof(float)) {
+    convertValues<float>(source, dest, count);
+  }
+  else {
+    convertValues<double>(source, dest, count);
+  }
+}
+
+} // namespace onex
+
+#endif // BINARY_FILE_H
@@ -0,0 +1,67 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <chrono>
+
+// The clock is read once every this many calls of Deadline::expired
+#define DEADLINE_CHECK_INTERVAL 16
+
+namespace onex {
+
+/**
+ *  @brief a time limit after which a search returns its best answer so far
+ *
+ *  The clock is only read once every DEADLINE_CHECK_INTERVAL calls of
+ *  expired, so it can be checked in tight loops. Once expired, a deadline
+ *  stays expired.
+ */
+class Deadline
+{
+public:
+  /**
+   *  @brief constructor for a deadline that never expires
+   */
+  Deadline() : limited(false), calls(0), reached(false) {}
+
+  /**
+   *  @brief constructor for a deadline some time from now
+   *
+   *  @param seconds time until the deadline. If it is not positive, the
+   *         deadline never expires
+   */
+  explicit Deadline(double seconds) : limited(seconds > 0), calls(0), reached(false)
+  {
+    if (this->limited)
+    {
+      this->end = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    }
+  }
+
+  /**
+   *  @return true if the deadline has passed
+   */
+  bool expired() const
+  {
+    if (this->limited && !this->reached && this->calls++ % DEADLINE_CHECK_INTERVAL == 0) {
+      this->reached = std::chrono::steady_clock::now() >= this->end;
+    }
+    return this->reached;
+  }
+
+  /**
+   *  @return true if expired has returned true, which means that a search
+   *          was cut short
+   */
+  bool isReached() const { return this->reached; }
+
+private:
+  bool limited;
+  std::chrono::steady_clock::time_point end;
+  mutable unsigned int calls;
+  mutable bool reached;
+};
+
+} // namespace onex
+
+#endif // DEADLINE_H
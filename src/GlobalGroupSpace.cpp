@@ -1,17 +1,25 @@
 #include "GlobalGroupSpace.hpp"
 #include "LocalLengthGroupSpace.hpp"
 #include <cmath>
+#include <cstring>
 #include <sstream>
 #include <functional>
 #include <queue>
 #include <vector>
 #include <fstream>
 #include <iostream>
+#include <random>
+#include <set>
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include "TimeSeries.hpp"
 #include "TimeSeriesSet.hpp"
 #include "distance/Distance.hpp"
 #include "Group.hpp"
+#include "GroupFile.hpp"
+#include "BinaryFile.hpp"
+#include "Parallel.hpp"
+#include "Deadline.hpp"
 
 using std::vector;
 using std::max;
@@ -31,52 +39,543 @@ void GlobalGroupSpace::reset(void)
     this->localLengthGroupSpace[i] = nullptr;
   }
   this->localLengthGroupSpace.clear();
+
+  delete this->groupFile;
+  this->groupFile = nullptr;
+  this->lengthOffsets.clear();
+  this->lastUsed.clear();
+  this->meanCentroids = false;
+}
+
+LocalLengthGroupSpace* GlobalGroupSpace::getLocalLengthGroupSpace(int length, int pinnedLength)
+{
+  LocalLengthGroupSpace* space = this->localLengthGroupSpace[length];
+  if (this->groupFile == nullptr) {
+    return space;
+  }
+
+  this->lastUsed[length] = ++this->useCount;
+  if (space == nullptr)
+  {
+    space = new LocalLengthGroupSpace(dataset, length);
+    if (this->lengthOffsets[length] > 0)
+    {
+      try {
+        space->loadGroupsBinary(*this->groupFile, this->lengthOffsets[length], this->groupFileHeader);
+      }
+      catch (...) {
+        delete space;
+        throw;
+      }
+    }
+    this->localLengthGroupSpace[length] = space;
+    this->evictLengths(pinnedLength);
+  }
+  return space;
+}
+
+void GlobalGroupSpace::evictLengths(int pinnedLength)
+{
+  if (this->memoryLimit == 0) {
+    return;
+  }
+
+  // Usage is counted again each time because cached envelopes make it grow
+  size_t memoryUsed = this->getMemoryUsage();
+
+  // The length being used is never evicted, so at least one length stays
+  while (memoryUsed > this->memoryLimit)
+  {
+    int oldest = -1;
+    for (unsigned int i = 0; i < this->localLengthGroupSpace.size(); i++)
+    {
+      if (this->localLengthGroupSpace[i] && (int)i != pinnedLength &&
+          this->lastUsed[i] != this->useCount &&
+          (oldest < 0 || this->lastUsed[i] < this->lastUsed[oldest]))
+      {
+        oldest = i;
+      }
+    }
+    if (oldest < 0) {
+      break;
+    }
+    memoryUsed -= this->localLengthGroupSpace[oldest]->getMemoryUsage();
+    delete this->localLengthGroupSpace[oldest];
+    this->localLengthGroupSpace[oldest] = nullptr;
+  }
+}
+
+void GlobalGroupSpace::loadAllLengths()
+{
+  if (this->groupFile == nullptr) {
+    return;
+  }
+  size_t memoryLimit = this->memoryLimit;
+  this->memoryLimit = 0;
+  for (unsigned int i = 2; i < this->localLengthGroupSpace.size(); i++) {
+    this->getLocalLengthGroupSpace(i);
+  }
+  this->memoryLimit = memoryLimit;
+
+  delete this->groupFile;
+  this->groupFile = nullptr;
+  this->lengthOffsets.clear();
+  this->lastUsed.clear();
+}
+
+void GlobalGroupSpace::setMemoryLimit(size_t bytes)
+{
+  this->memoryLimit = bytes;
+  if (this->groupFile)
+  {
+    // No length is in use here, so any of them can be evicted
+    this->useCount++;
+    this->evictLengths(-1);
+  }
+}
+
+int GlobalGroupSpace::getLoadedLengthCount() const
+{
+  int count = 0;
+  for (unsigned int i = 0; i < this->localLengthGroupSpace.size(); i++) {
+    count += this->localLengthGroupSpace[i] != nullptr;
+  }
+  return count;
+}
+
+size_t GlobalGroupSpace::getMemoryUsage() const
+{
+  size_t bytes = sizeof(*this)
+    + this->localLengthGroupSpace.capacity() * sizeof(LocalLengthGroupSpace*)
+    + (this->lengthOffsets.capacity() + this->lastUsed.capacity()) * sizeof(uint64_t);
+  for (unsigned int i = 0; i < this->localLengthGroupSpace.size(); i++) {
+    bytes += this->getMemoryUsage(i);
+  }
+  return bytes;
+}
+
+size_t GlobalGroupSpace::getMemoryUsage(int length) const
+{
+  if (length < 0 || length >= (int)this->localLengthGroupSpace.size() ||
+      this->localLengthGroupSpace[length] == nullptr)
+  {
+    return 0;
+  }
+  return this->localLengthGroupSpace[length]->getMemoryUsage();
+}
+
+size_t GlobalGroupSpace::getKeoghCacheMemoryUsage() const
+{
+  size_t bytes = 0;
+  for (unsigned int i = 0; i < this->localLengthGroupSpace.size(); i++)
+  {
+    if (this->localLengthGroupSpace[i]) {
+      bytes += this->localLengthGroupSpace[i]->getKeoghCacheMemoryUsage();
+    }
+  }
+  return bytes;
+}
+
+size_t GlobalGroupSpace::getMappedMemoryUsage() const
+{
+  return this->groupFile ? this->groupFile->getSize() : 0;
+}
+
+/**
+ *  @brief spreads a number of lengths evenly between 2 and itemLength, both included
+ */
+static vector<int> getSampleLengths(int itemLength, int sampleLengths)
+{
+  sampleLengths = max(1, min(sampleLengths, itemLength - 1));
+  vector<int> lengths;
+  for (int i = 0; i < sampleLengths; i++)
+  {
+    int length = sampleLengths == 1 ? (itemLength + 2) / 2
+                                    : 2 + (long long)i * (itemLength - 2) / (sampleLengths - 1);
+    if (lengths.empty() || lengths.back() != length) {
+      lengths.push_back(length);
+    }
+  }
+  return lengths;
+}
+
+/**
+ *  @brief interpolates linearly the group counts of the sampled lengths to all
+ *         lengths. The result is indexed by length
+ */
+static vector<double> interpolateGroupCounts(const vector<int>& lengths, const vector<double>& counts,
+                                             int itemLength)
+{
+  vector<double> result(itemLength + 1, 0);
+  unsigned int next = 0;
+  for (int length = 2; length <= itemLength; length++)
+  {
+    while (next < lengths.size() && lengths[next] < length) {
+      next++;
+    }
+    if (next == lengths.size()) {
+      result[length] = counts.back();
+    }
+    else if (lengths[next] == length || next == 0) {
+      result[length] = counts[next];
+    }
+    else
+    {
+      double w = double(length - lengths[next - 1]) / (lengths[next] - lengths[next - 1]);
+      result[length] = counts[next - 1] + w * (counts[next] - counts[next - 1]);
+    }
+  }
+  return result;
+}
+
+/**
+ *  @brief counts the groups that generateGroups would make out of the first
+ *         count sub-sequences of a sample
+ */
+static int countGroups(const TimeSeriesSet& dataset, int length, const vector<uint32_t>& sample,
+                       size_t count, const dist_t distance, data_t threshold)
+{
+  int subTimeSeriesCount = dataset.getItemLength() - length + 1;
+  vector<TimeSeries> centroids;
+  for (size_t i = 0; i < count; i++)
+  {
+    int start = sample[i] % subTimeSeriesCount;
+    TimeSeries query = dataset.getTimeSeries(sample[i] / subTimeSeriesCount, start, start + length);
+    // Only whether some centroid is close enough matters, not which one
+    bool grouped = false;
+    for (unsigned int j = 0; j < centroids.size() && !grouped; j++) {
+      grouped = distance(centroids[j], query, threshold / 2) <= threshold / 2;
+    }
+    if (!grouped) {
+      centroids.push_back(query);
+    }
+  }
+  return centroids.size();
+}
+
+group_estimate_t GlobalGroupSpace::estimateGroups(const string& distance_name, data_t threshold,
+                                                  int sampleLengths) const
+{
+  dist_t distance = getDistance(distance_name);
+  int itemCount = dataset.getItemCount();
+  int itemLength = dataset.getItemLength();
+
+  group_estimate_t estimate;
+  estimate.groupCount = 0;
+  estimate.memoryUsage = sizeof(GlobalGroupSpace) + (itemLength + 1) * sizeof(LocalLengthGroupSpace*);
+  estimate.peakMemoryUsage = estimate.memoryUsage;
+  if (itemLength < 2) {
+    return estimate;
+  }
+
+  vector<int> lengths = getSampleLengths(itemLength, sampleLengths);
+  vector<double> counts;
+  for (unsigned int i = 0; i < lengths.size(); i++)
+  {
+    LocalLengthGroupSpace space(dataset, lengths[i]);
+    counts.push_back(space.generateGroups(distance, threshold));
+  }
+
+  vector<double> allCounts = interpolateGroupCounts(lengths, counts, itemLength);
+  for (int length = 2; length <= itemLength; length++)
+  {
+    int groupCount = std::lround(allCounts[length]);
+    estimate.groupCount += groupCount;
+    estimate.memoryUsage += LocalLengthGroupSpace::estimateMemoryUsage(itemCount, itemLength, length, groupCount);
+  }
+
+  // Only one member map is alive at a time, and the one of length 2 is the largest
+  estimate.peakMemoryUsage = estimate.memoryUsage +
+    LocalLengthGroupSpace::estimateBuildMemoryUsage(itemCount, itemLength, 2);
+  return estimate;
+}
+
+threshold_selection_t GlobalGroupSpace::selectThreshold(const string& distance_name,
+                                                        int maxGroupCount, size_t maxMemoryUsage,
+                                                        int sampleSize, int sampleLengths,
+                                                        int numThreads) const
+{
+  dist_t distance = getDistance(distance_name);
+  int itemCount = dataset.getItemCount();
+  int itemLength = dataset.getItemLength();
+  if (itemLength < 2 || itemCount == 0) {
+    throw OnexException("Dataset is too short to be grouped");
+  }
+  if (maxGroupCount <= 0 && maxMemoryUsage == 0) {
+    throw OnexException("A group count or memory budget is needed");
+  }
+  sampleSize = max(sampleSize, 2);
+
+  // A fixed seed makes the selection repeatable
+  std::mt19937 rng(2017);
+  vector<int> lengths = getSampleLengths(itemLength, sampleLengths);
+  vector<vector<uint32_t> > samples(lengths.size());
+  vector<size_t> populations(lengths.size());
+  data_t maxDistance = 0;
+  for (unsigned int i = 0; i < lengths.size(); i++)
+  {
+    int subTimeSeriesCount = itemLength - lengths[i] + 1;
+    uint32_t population = (uint64_t)itemCount * subTimeSeriesCount;
+    vector<uint32_t>& sample = samples[i];
+    if (population <= (uint32_t)sampleSize)
+    {
+      for (uint32_t j = 0; j < population; j++) {
+        sample.push_back(j);
+      }
+    }
+    else
+    {
+      // Floyd's algorithm picks distinct sub-sequences
+      std::set<uint32_t> picked;
+      for (uint32_t j = population - sampleSize; j < population; j++)
+      {
+        uint32_t k = std::uniform_int_distribution<uint32_t>(0, j)(rng);
+        picked.insert(picked.count(k) ? j : k);
+      }
+      sample.assign(picked.begin(), picked.end());
+    }
+    std::shuffle(sample.begin(), sample.end(), rng);
+    populations[i] = population;
+
+    // Every sub-sequence of the sample is within maxDistance of the first one
+    int start = sample[0] % subTimeSeriesCount;
+    TimeSeries first = dataset.getTimeSeries(sample[0] / subTimeSeriesCount, start, start + lengths[i]);
+    for (unsigned int j = 1; j < sample.size(); j++)
+    {
+      start = sample[j] % subTimeSeriesCount;
+      TimeSeries other = dataset.getTimeSeries(sample[j] / subTimeSeriesCount, start, start + lengths[i]);
+      maxDistance = max(maxDistance, distance(first, other, INF));
+    }
+  }
+
+  // Predicts the number of groups of every length for a threshold. The count
+  // on the whole sample and on half of it gives the rate at which the count
+  // grows with the number of sub-sequences, which extrapolates it
+  auto predict = [&](const vector<data_t>& thresholds) {
+    vector<vector<double> > counts(thresholds.size(), vector<double>(lengths.size()));
+    parallelFor(thresholds.size() * lengths.size(), numThreads, [&](int task) {
+      int t = task / lengths.size();
+      int i = task % lengths.size();
+      const vector<uint32_t>& sample = samples[i];
+      double full = countGroups(dataset, lengths[i], sample, sample.size(), distance, thresholds[t]);
+      if (sample.size() < populations[i])
+      {
+        double half = countGroups(dataset, lengths[i], sample, sample.size() / 2, distance, thresholds[t]);
+        double rate = std::log(full / half) / std::log(double(sample.size()) / (sample.size() / 2));
+        rate = max(0.0, min(1.0, rate));
+        full *= std::pow(double(populations[i]) / sample.size(), rate);
+      }
+      counts[t][i] = full;
+    });
+
+    vector<threshold_selection_t> predictions;
+    for (unsigned int t = 0; t < thresholds.size(); t++)
+    {
+      threshold_selection_t prediction;
+      prediction.threshold = thresholds[t];
+      prediction.groupCount = 0;
+      prediction.memoryUsage = sizeof(GlobalGroupSpace) + (itemLength + 1) * sizeof(LocalLengthGroupSpace*);
+      vector<double> allCounts = interpolateGroupCounts(lengths, counts[t], itemLength);
+      for (int length = 2; length <= itemLength; length++)
+      {
+        int groupCount = std::lround(allCounts[length]);
+        prediction.groupCount += groupCount;
+        prediction.memoryUsage += LocalLengthGroupSpace::estimateMemoryUsage(
+          itemCount, itemLength, length, groupCount);
+      }
+      predictions.push_back(prediction);
+    }
+    return predictions;
+  };
+
+  auto withinBudget = [&](const threshold_selection_t& prediction) {
+    return (maxGroupCount <= 0 || prediction.groupCount <= maxGroupCount) &&
+           (maxMemoryUsage == 0 || prediction.memoryUsage <= maxMemoryUsage);
+  };
+
+  // Thresholds from one that puts the whole sample in one group down to a
+  // small fraction of it. Fewer groups are made for larger thresholds
+  const int gridSize = 13;
+  vector<data_t> grid;
+  for (int k = 0; k < gridSize; k++) {
+    grid.push_back(2 * maxDistance * std::pow(2.0, -0.5 * k) + EPS);
+  }
+  vector<threshold_selection_t> predictions = predict(grid);
+
+  int fail = 0;
+  while (fail < gridSize && withinBudget(predictions[fail])) {
+    fail++;
+  }
+  if (fail == 0 || fail == gridSize) {
+    // Either no threshold meets the budget or the smallest one does
+    return predictions[max(0, fail - 1)];
+  }
+
+  // The count and the memory are close to power laws of the threshold, so the
+  // threshold where the budget is reached is interpolated on a log scale.
+  // Interpolation alternates with bisection because it may keep landing on
+  // the same side of the budget
+  threshold_selection_t ok = predictions[fail - 1];
+  threshold_selection_t over = predictions[fail];
+  for (int iteration = 0; iteration < 6; iteration++)
+  {
+    double fraction = 1;
+    auto cross = [&](double budget, double low, double high) {
+      if (budget > 0 && high > budget && high > low) {
+        fraction = min(fraction, (std::log(budget) - std::log(max(low, 1.0))) /
+                                 (std::log(high) - std::log(max(low, 1.0))));
+      }
+    };
+    cross(maxGroupCount, ok.groupCount, over.groupCount);
+    cross(maxMemoryUsage, ok.memoryUsage, over.memoryUsage);
+    fraction = iteration % 2 ? 0.5 : max(0.0, min(1.0, fraction));
+    data_t threshold = std::exp(std::log(ok.threshold) +
+                                fraction * (std::log(over.threshold) - std::log(ok.threshold)));
+
+    threshold_selection_t selection = predict(vector<data_t>(1, threshold))[0];
+    if (withinBudget(selection)) {
+      ok = selection;
+    }
+    else {
+      over = selection;
+    }
+  }
+  return ok;
+}
+
+int GlobalGroupSpace::dropSingletonGroups()
+{
+  int dropped = 0;
+  for (unsigned int i = 0; i < this->localLengthGroupSpace.size(); i++)
+  {
+    if (this->localLengthGroupSpace[i]) {
+      dropped += this->localLengthGroupSpace[i]->dropSingletonGroups();
+    }
+  }
+  return dropped;
+}
+
+refine_result_t GlobalGroupSpace::refine(data_t threshold, int iterations, int minGroupSize, int numThreads)
+{
+  this->loadAllLengths();
+  this->threshold = threshold;
+  refine_result_t result;
+  result.groupCountBefore = 0;
+  result.groupCount = 0;
+  result.memoryUsageBefore = this->getMemoryUsage();
+  // Only mean centroids need to be saved with their values
+  this->meanCentroids = false;
+  for (unsigned int i = 2; i < this->localLengthGroupSpace.size(); i++)
+  {
+    bool hasMeanCentroids;
+    result.groupCountBefore += this->localLengthGroupSpace[i]->getNumberOfGroups();
+    result.groupCount += this->localLengthGroupSpace[i]->refineGroups(this->pairwiseDistance, this->threshold,
+                                                                     iterations, minGroupSize, numThreads,
+                                                                     hasMeanCentroids);
+    this->meanCentroids = this->meanCentroids || hasMeanCentroids;
+  }
+  result.memoryUsage = this->getMemoryUsage();
+  return result;
 }
 
 void GlobalGroupSpace::loadDistance(const string& distance_name)
 {
   this->distanceName = distance_name;
   this->pairwiseDistance = getDistance(distance_name);
-  this->warpedDistance = cascadeDistance;
+  this->batchWarpedDistance = cascadeDistanceBatch;
 }
 
-int GlobalGroupSpace::group(const string& distance_name, data_t threshold)
+int GlobalGroupSpace::group(const string& distance_name, data_t threshold, int numThreads,
+                            group_order_t order, bool meanCentroids)
 {
   reset();
   this->loadDistance(distance_name);
   this->localLengthGroupSpace.resize(dataset.getItemLength() + 1, nullptr);
   this->threshold = threshold;
+  this->meanCentroids = numThreads == 1 && meanCentroids;
   int numberOfGroups = 0;
 
   for (unsigned int i = 2; i < this->localLengthGroupSpace.size(); i++)
   {
     this->localLengthGroupSpace[i] = new LocalLengthGroupSpace(dataset, i);
-    int noOfGenerated = this->localLengthGroupSpace[i]->generateGroups(this->pairwiseDistance, threshold);
+    int noOfGenerated = numThreads == 1
+      ? this->localLengthGroupSpace[i]->generateGroups(this->pairwiseDistance, threshold, order, meanCentroids)
+      : this->localLengthGroupSpace[i]->generateGroups(this->pairwiseDistance, threshold, numThreads);
     numberOfGroups += noOfGenerated;
   }
   return numberOfGroups;
 }
 
 candidate_time_series_t GlobalGroupSpace::getBestMatch(const TimeSeries& query)
+{
+  return this->getBestMatch(query, match_options_t()).match;
+}
+
+match_result_t GlobalGroupSpace::getBestMatch(const TimeSeries& query, const match_options_t& options)
 {
   if (query.getLength() <= 1) {
     throw OnexException("Length of query must be larger than 1");
   }
   data_t bestSoFarDist = INF;
   const Group* bestSoFarGroup = nullptr;
+  int bestSoFarLength = -1;
 
   vector<int> order (generateTraverseOrder(query.getLength(), this->localLengthGroupSpace.size() - 1));
+  match_result_t result;
+  result.lengthsVisited = 0;
+  result.lengthCount = order.size();
+  result.groupsVisited = 0;
+  Deadline deadline(options.timeBudget);
+  bool stoppedEarly = false;
+
   for (unsigned int io = 0; io < order.size(); io++) {
     int i = order[io];
+    // Limits only apply once there is something to return
+    bool outOfBudget = (options.maxLengths > 0 && result.lengthsVisited >= options.maxLengths)
+      || (options.maxGroups > 0 && result.groupsVisited >= options.maxGroups)
+      || deadline.expired();
+    if (bestSoFarGroup != nullptr && (bestSoFarDist <= options.epsilon || outOfBudget))
+    {
+      stoppedEarly = true;
+      break;
+    }
+    // The length of the best group so far must stay loaded
+    LocalLengthGroupSpace* space = this->getLocalLengthGroupSpace(i, bestSoFarLength);
+    // Skip the length if no centroid can beat the best so far
+    if (bestSoFarDist < INF && space->getLowerBound(query) >= bestSoFarDist) {
+      continue;
+    }
     // this looks through each group of a certain length finding the best of those groups
-    candidate_group_t candidate = this->localLengthGroupSpace[i]->getBestGroup(query, this->warpedDistance, bestSoFarDist);
+    space->buildSuperGroups(this->pairwiseDistance);
+    int maxGroups = options.maxGroups > 0 ? std::max(options.maxGroups - result.groupsVisited, 1) : 0;
+    int visited = 0;
+    candidate_group_t candidate = space->getBestGroup(query, this->batchWarpedDistance, bestSoFarDist,
+                                                      options.epsilon, maxGroups, deadline, visited);
+    result.lengthsVisited++;
+    result.groupsVisited += visited;
     if (candidate.second < bestSoFarDist)
     {
       bestSoFarGroup = candidate.first;
       bestSoFarDist = candidate.second;
+      bestSoFarLength = i;
     }
+    // The scan of the length may have stopped before its end
+    if (bestSoFarDist <= options.epsilon || (options.maxGroups > 0 && result.groupsVisited >= options.maxGroups)) {
+      stoppedEarly = true;
+    }
+  }
+  if (bestSoFarGroup == nullptr) {
+    throw OnexException("No group found");
+  }
+  if (options.allLengths) {
+    result.match = bestSoFarGroup->getBestMatchAcrossLengths(query, order, deadline);
   }
-  return bestSoFarGroup->getBestMatch(query, this->warpedDistance);
+  else {
+    result.match = bestSoFarGroup->getBestMatch(query, this->batchWarpedDistance, deadline);
+  }
+  // Nothing can be closer than a distance of 0
+  result.complete = !deadline.isReached() && (!stoppedEarly || bestSoFarDist == 0);
+  return result;
 }
 
 bool GlobalGroupSpace::grouped(void) const
@@ -84,13 +583,13 @@ bool GlobalGroupSpace::grouped(void) const
   return localLengthGroupSpace.size() > 0;
 }
 
-void GlobalGroupSpace::saveGroups(ofstream &fout, bool groupSizeOnly) const
+void GlobalGroupSpace::saveGroups(ofstream &fout, bool groupSizeOnly)
 {
   // Range of lengths and distance name
   fout << 2 << " " << this->localLengthGroupSpace.size() << endl;
   fout << this->distanceName << endl;
   for (unsigned int i = 2; i < this->localLengthGroupSpace.size(); i++) {
-    this->localLengthGroupSpace[i]->saveGroups(fout, groupSizeOnly);
+    this->getLocalLengthGroupSpace(i)->saveGroups(fout, groupSizeOnly);
   }
 }
 
@@ -113,6 +612,87 @@ int GlobalGroupSpace::loadGroups(ifstream &fin)
   return numberOfGroups;
 }
 
+void GlobalGroupSpace::saveGroupsBinary(ofstream &fout)
+{
+  group_space_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.lenFrom = 2;
+  header.lenTo = this->localLengthGroupSpace.size();
+  strncpy(header.distance, this->distanceName.c_str(), sizeof(header.distance) - 1);
+  fout.write((const char*)&header, sizeof(header));
+
+  // The table is filled in after the sections are written
+  std::streamoff tableOffset = fout.tellp();
+  vector<uint64_t> offsets(header.lenTo - header.lenFrom, 0);
+  fout.write((const char*)offsets.data(), offsets.size() * sizeof(uint64_t));
+
+  for (unsigned int i = header.lenFrom; i < header.lenTo; i++)
+  {
+    writePadding(fout);
+    offsets[i - header.lenFrom] = fout.tellp();
+    this->getLocalLengthGroupSpace(i)->saveGroupsBinary(fout);
+  }
+
+  std::streamoff end = fout.tellp();
+  fout.seekp(tableOffset);
+  fout.write((const char*)offsets.data(), offsets.size() * sizeof(uint64_t));
+  fout.seekp(end);
+}
+
+int GlobalGroupSpace::loadGroupsBinary(MappedFile* file, uint64_t offset,
+                                       const group_file_header_t& fileHeader)
+{
+  reset();
+  this->groupFile = file;
+  this->groupFileHeader = fileHeader;
+  this->meanCentroids = fileHeader.flags & GROUP_FILE_MEAN_CENTROIDS;
+
+  group_space_header_t header = *getSection<group_space_header_t>(*file, offset, 1);
+  header.distance[sizeof(header.distance) - 1] = '\0';
+  if (header.lenFrom < 2 || header.lenFrom > header.lenTo ||
+      header.lenTo > (uint32_t)dataset.getItemLength() + 1)
+  {
+    throw OnexException("Group file is corrupted");
+  }
+  const uint64_t* offsets = getSection<uint64_t>(*file, offset + sizeof(header),
+                                                 header.lenTo - header.lenFrom);
+
+  this->loadDistance(header.distance);
+  this->localLengthGroupSpace.resize(dataset.getItemLength() + 1, nullptr);
+  this->lengthOffsets.resize(dataset.getItemLength() + 1, 0);
+  this->lastUsed.resize(dataset.getItemLength() + 1, 0);
+
+  // Only the number of groups is read for now
+  int numberOfGroups = 0;
+  for (unsigned int i = header.lenFrom; i < header.lenTo; i++)
+  {
+    uint64_t lengthOffset = offsets[i - header.lenFrom];
+    if (lengthOffset == 0)
+    {
+      throw OnexException("Group file is corrupted");
+    }
+    this->lengthOffsets[i] = lengthOffset;
+    numberOfGroups += getSection<group_length_header_t>(*file, lengthOffset, 1)->groupCount;
+  }
+  return numberOfGroups;
+}
+
+candidate_time_series_t GlobalGroupSpace::getBestMatchEuclidean(const TimeSeries& query)
+{
+  if (this->distanceName != "euclidean") {
+    throw OnexException("Groups were not made with the Euclidean distance");
+  }
+  if (query.getLength() <= 1 || query.getLength() >= (int)this->localLengthGroupSpace.size()) {
+    throw OnexException("Length of query must be larger than 1 and at most the item length");
+  }
+  candidate_time_series_t best =
+    this->getLocalLengthGroupSpace(query.getLength())->getBestMatchByMetric(query, this->pairwiseDistance, INF);
+  if (best.data.getLength() == 0) {
+    throw OnexException("No group found");
+  }
+  return best;
+}
+
 vector<int> generateTraverseOrder(int queryLength, int totalLength)
 {
   vector<int> order;
@@ -12,6 +12,69 @@
 
 namespace onex {
 
+/**
+ *  @brief a prediction of the size of the groups of a dataset
+ */
+struct group_estimate_t
+{
+  int groupCount;
+  size_t memoryUsage;      // bytes used by the groups once grouping is done
+  size_t peakMemoryUsage;  // bytes used at most while grouping
+};
+
+/**
+ *  @brief a threshold chosen for a budget and the predicted size of the groups
+ */
+struct threshold_selection_t
+{
+  data_t threshold;
+  int groupCount;
+  size_t memoryUsage;
+};
+
+/**
+ *  @brief the size of the groups before and after refinement
+ */
+struct refine_result_t
+{
+  int groupCountBefore;
+  int groupCount;
+  size_t memoryUsageBefore;
+  size_t memoryUsage;
+};
+
+/**
+ *  @brief limits of an approximate search for the best match. A limit of 0
+ *         means no limit
+ */
+struct match_options_t
+{
+  data_t epsilon;     // the search stops at the first centroid within this
+                      // distance. It is a tolerance on the centroid, so the
+                      // match, a member of its group, may be farther
+  int maxGroups;      // maximum number of centroids compared with the query
+  int maxLengths;     // maximum number of lengths whose groups are searched
+  double timeBudget;  // seconds after which the best match so far is returned
+  bool allLengths;    // whether the members of the best group are compared
+                      // at every length from their start, not only at the
+                      // length of the group
+
+  match_options_t() : epsilon(0), maxGroups(0), maxLengths(0), timeBudget(0), allLengths(false) {}
+};
+
+/**
+ *  @brief a match found by a search and how much of the search was done
+ */
+struct match_result_t
+{
+  candidate_time_series_t match;
+  int lengthsVisited;  // lengths whose groups were compared with the query
+  int lengthCount;     // lengths that a full search considers
+  int groupsVisited;   // centroids compared with the query
+  bool complete;       // false if the search stopped before the end, so a
+                       // better match may exist
+};
+
 /**
  *  The set of all groups of equal lengths for a dataset
  */
@@ -46,20 +109,226 @@ public:
    *
    *  @param metric the metric used to group by
    *  @param threshold the threshold to be group with
+   *  @param numThreads number of threads. With one thread, each length is
+   *         grouped sequentially. Otherwise the two-phase grouping of
+   *         LocalLengthGroupSpace is used. See getNumberOfThreads
+   *  @param order the order in which the sub-sequences of each length are
+   *         grouped sequentially. It is ignored with more than one thread
+   *  @param meanCentroids whether centroids are the mean of their members,
+   *         see LocalLengthGroupSpace::generateGroups. It is ignored with
+   *         more than one thread
    *  @return the number of groups it creates
    */
-  int group(const std::string& distance_name, data_t threshold);
+  int group(const std::string& distance_name, data_t threshold, int numThreads = 1,
+            group_order_t order = GROUP_ORDER_START, bool meanCentroids = false);
+
+  /**
+   *  @brief returns true if the computed centroids are the means of their
+   *         members, rather than copies of a member loaded from text
+   */
+  bool hasMeanCentroids(void) const { return this->meanCentroids; }
  
   /**
    *  @brief gets the most similar sequence in the dataset
    *
+   *  Lengths are visited in the order of generateTraverseOrder. A length is
+   *  skipped when its lower bound, see LocalLengthGroupSpace::getLowerBound,
+   *  is not less than the best distance so far.
+   *
    *  @param query gets most similar sequence to the query
    *  @return the best match in the dataset
    */
   candidate_time_series_t getBestMatch(const TimeSeries& query);
 
-  void saveGroups(std::ofstream &fout, bool groupSizeOnly) const;
+  /**
+   *  @brief gets a sequence similar to the query, stopping early
+   *
+   *  The search is the one of getBestMatch, except that it stops at the
+   *  first centroid within options.epsilon of the query, once it has
+   *  compared options.maxGroups centroids or searched options.maxLengths
+   *  lengths, or after options.timeBudget seconds. The match is then the
+   *  closest member of the best group so far, or the closest one found in
+   *  time. With the default options, the result is the one of getBestMatch.
+   *  Since options.epsilon is checked against centroids, the match can be
+   *  farther than options.epsilon from the query, e.g. when the centroid is
+   *  the mean of the members.
+   *
+   *  Lengths are searched from the length of the query outward, and the
+   *  groups of a length best-first through its super-groups, by lower
+   *  bounds of their distance to the query, see
+   *  LocalLengthGroupSpace::getBestGroup. So the early answers are usually
+   *  good ones.
+   *
+   *  With options.allLengths, the sub-sequences that start where a member
+   *  of the best group starts are compared at every length, which finds a
+   *  match at least as close for little more work, see
+   *  Group::getBestMatchAcrossLengths.
+   *
+   *  @param query the query
+   *  @param options limits of the search
+   *  @return the match and how much of the search was done
+   *
+   *  @throw OnexException if no group is found
+   */
+  match_result_t getBestMatch(const TimeSeries& query, const match_options_t& options);
+
+  /**
+   *  @brief gets the sub-sequence closest to a query by Euclidean distance
+   *
+   *  Only the groups of the query's length are searched, and they are pruned
+   *  by the triangle inequality, see LocalLengthGroupSpace::getBestMatchByMetric.
+   *  The result is exact, unlike getBestMatch.
+   *
+   *  @param query the query
+   *  @return the best match of the same length as the query
+   *
+   *  @throw OnexException if the groups were not made with the Euclidean
+   *         distance or the query length is out of range
+   */
+  candidate_time_series_t getBestMatchEuclidean(const TimeSeries& query);
+
+  void saveGroups(std::ofstream &fout, bool groupSizeOnly);
   int loadGroups(std::ifstream &fin);
+
+  /**
+   *  @brief writes the groups of all lengths to a binary group file
+   *
+   *  The range of lengths and the distance are followed by a table with the
+   *  offset of the section of each length, so that a length can be read
+   *  without reading the lengths before it.
+   *
+   *  @param fout the file. The groups are written from its current position
+   */
+  void saveGroupsBinary(std::ofstream &fout);
+
+  /**
+   *  @brief registers the groups of all lengths in a binary group file
+   *
+   *  Only the offset table and the header of each length are read here. The
+   *  groups of a length are loaded the first time they are needed. If a
+   *  memory limit is set, the lengths used least recently are unloaded to
+   *  stay under it and loaded again from the file when needed.
+   *
+   *  @param file the mapped group file. This object takes ownership of it
+   *  @param offset offset of the groups in the file
+   *  @param fileHeader header of the file
+   *  @return number of groups in the file
+   *
+   *  @throw OnexException if the file is corrupted
+   */
+  int loadGroupsBinary(MappedFile* file, uint64_t offset,
+                       const group_file_header_t& fileHeader);
+
+  /**
+   *  @brief sets the maximum memory used by the groups of lengths loaded from
+   *         a binary group file
+   *
+   *  The limit is approximate: the lengths needed by a single query are
+   *  always kept, even if they exceed it. Groups that were not loaded from a
+   *  binary group file are never unloaded.
+   *
+   *  @param bytes the limit in bytes. 0 means no limit
+   */
+  void setMemoryLimit(size_t bytes);
+
+  /**
+   *  @brief gets the number of lengths whose groups are in memory
+   */
+  int getLoadedLengthCount() const;
+
+  /**
+   *  @brief gets the number of bytes used by the groups of all lengths in memory
+   */
+  size_t getMemoryUsage() const;
+
+  /**
+   *  @brief gets the number of bytes used by the groups of a length
+   *
+   *  @param length the length
+   *  @return the number of bytes, or 0 if the groups of this length are not
+   *          in memory
+   */
+  size_t getMemoryUsage(int length) const;
+
+  /**
+   *  @brief gets the number of bytes of the Keogh envelopes cached for the
+   *         centroids. They are included in getMemoryUsage
+   */
+  size_t getKeoghCacheMemoryUsage() const;
+
+  /**
+   *  @brief gets the size of the group file mapped into memory, or 0 if the
+   *         groups were not loaded from a binary group file
+   */
+  size_t getMappedMemoryUsage() const;
+
+  /**
+   *  @brief predicts the number of groups and the memory that group would use
+   *         without grouping the whole dataset
+   *
+   *  Only sampleLengths lengths, spread evenly between 2 and the item length,
+   *  are grouped. The number of groups of the other lengths is interpolated
+   *  linearly between them. This object is not changed.
+   *
+   *  @param distance_name the distance to use for grouping
+   *  @param threshold the threshold to use for grouping
+   *  @param sampleLengths number of lengths to group
+   *  @return the prediction
+   */
+  group_estimate_t estimateGroups(const std::string& distance_name, data_t threshold,
+                                  int sampleLengths) const;
+
+  /**
+   *  @brief chooses the smallest threshold whose groups are predicted to fit
+   *         in a budget, without grouping the dataset
+   *
+   *  A random sample of sub-sequences is grouped at a few lengths for a
+   *  range of thresholds. The number of groups of the whole dataset is
+   *  extrapolated from the growth of the count between half of the sample
+   *  and all of it, and interpolated between the sampled lengths. The
+   *  threshold where the prediction reaches the budget is interpolated on a
+   *  log scale. This object is not changed.
+   *
+   *  @param distance_name the distance to use for grouping
+   *  @param maxGroupCount maximum number of groups. 0 means no limit
+   *  @param maxMemoryUsage maximum bytes used by the groups. 0 means no limit
+   *  @param sampleSize number of sub-sequences sampled at each length
+   *  @param sampleLengths number of sampled lengths
+   *  @param numThreads number of threads. See getNumberOfThreads
+   *  @return the threshold and the predicted size of its groups. If no
+   *          threshold meets the budget, the largest tried is returned
+   *
+   *  @throw OnexException if there is no budget or the dataset is too short
+   */
+  threshold_selection_t selectThreshold(const std::string& distance_name,
+                                        int maxGroupCount, size_t maxMemoryUsage,
+                                        int sampleSize, int sampleLengths,
+                                        int numThreads) const;
+
+  /**
+   *  @brief removes the groups with a single member from the lengths in memory
+   *
+   *  The sub-sequences of the removed groups can no longer be matched.
+   *
+   *  @return number of removed groups
+   */
+  int dropSingletonGroups();
+
+  /**
+   *  @brief refines the groups of every length, see
+   *         LocalLengthGroupSpace::refineGroups
+   *
+   *  Groups loaded from a binary group file are all read into memory first
+   *  and the file is no longer used.
+   *
+   *  @param threshold the threshold the groups were made with
+   *  @param iterations maximum number of iterations per length
+   *  @param minGroupSize groups with fewer members are merged into others
+   *  @param numThreads number of threads. See getNumberOfThreads
+   *  @return the number of groups and their memory usage before and after
+   */
+  refine_result_t refine(data_t threshold, int iterations, int minGroupSize, int numThreads = 1);
+
   /**
    *  @brief returns true if dataset is grouped
    */
@@ -69,8 +338,21 @@ private:
 
   std::vector<LocalLengthGroupSpace*> localLengthGroupSpace;
   const TimeSeriesSet& dataset;
+
+  // Set if the groups come from a binary group file and are loaded lazily
+  MappedFile* groupFile = nullptr;
+  group_file_header_t groupFileHeader;
+  std::vector<uint64_t> lengthOffsets;
+  std::vector<uint64_t> lastUsed;
+  uint64_t useCount = 0;
+  size_t memoryLimit = 0;
+  bool meanCentroids = false;
+
+  LocalLengthGroupSpace* getLocalLengthGroupSpace(int length, int pinnedLength = -1);
+  void evictLengths(int pinnedLength);
+  void loadAllLengths();
   dist_t pairwiseDistance;
-  dist_t warpedDistance;
+  batch_dist_t batchWarpedDistance;
   data_t threshold;
   std::string distanceName;
 
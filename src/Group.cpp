@@ -4,8 +4,10 @@
 #include <fstream>
 #include <vector>
 #include <algorithm>
+#include <utility>
 
 #include "TimeSeries.hpp"
+#include "Exception.hpp"
 #include "distance/Distance.hpp"
 
 using std::vector;
@@ -17,15 +19,46 @@ namespace onex {
 
 void Group::addMember(int tsIndex, int tsStart)
 {
+  if (this->frozenMembers) {
+    throw OnexException("Cannot add a member to a frozen group");
+  }
   this->count++;
   this->memberMap[tsIndex * this->subTimeSeriesCount + tsStart] =
     group_membership_t(this->groupIndex, this->lastMemberCoord);
   this->lastMemberCoord = std::make_pair(tsIndex, tsStart);
 }
 
+void Group::setMembers(const uint32_t* members, int count)
+{
+  this->frozenMembers = members;
+  this->frozenDistances = nullptr;
+  this->count = count;
+  this->lastMemberCoord = std::make_pair(-1, -1);
+}
+
 void Group::setCentroid(int tsIndex, int tsStart)
 {
   this->centroid = this->dataset.getTimeSeries(tsIndex, tsStart, tsStart + this->memberLength);
+  this->centroidCoord = std::make_pair(tsIndex, tsStart);
+}
+
+void Group::setCentroid(const TimeSeries& values)
+{
+  // The values may be the centroid itself, so they are copied before it is replaced
+  TimeSeries copy(this->memberLength);
+  memcpy(&copy[0], &values[0], this->memberLength * sizeof(data_t));
+  this->centroid = std::move(copy);
+  this->centroidCoord = std::make_pair(-1, -1);
+}
+
+void Group::setMeanCentroid(const TimeSeries& sum, int count)
+{
+  TimeSeries mean(this->memberLength);
+  for (int i = 0; i < this->memberLength; i++) {
+    mean[i] = sum[i] / count;
+  }
+  this->centroid = std::move(mean);
+  this->centroidCoord = std::make_pair(-1, -1);
 }
 
 data_t Group::distanceFromCentroid(const TimeSeries& query, const dist_t distance, data_t dropout)
@@ -34,28 +67,55 @@ data_t Group::distanceFromCentroid(const TimeSeries& query, const dist_t distanc
   return d;
 }
 
-candidate_time_series_t Group::getBestMatch(const TimeSeries& query, const dist_t warpedDistance) const
+candidate_time_series_t Group::getBestMatch(const TimeSeries& query, const dist_t distance) const
 {
-  member_coord_t currentMemberCoord = this->lastMemberCoord;
+  batch_dist_t batch = [distance](const TimeSeries& a, const vector<const TimeSeries*>& b, data_t dropout) {
+    return batchDistance(distance, a, b, dropout);
+  };
+  return this->getBestMatch(query, batch, Deadline());
+}
 
+candidate_time_series_t Group::getBestMatch(const TimeSeries& query, const batch_dist_t& distance,
+                                            const Deadline& deadline) const
+{
   data_t bestSoFarDist = INF;
   member_coord_t bestSoFarMember;
 
-  while (currentMemberCoord.first != -1)
-  {
-    int currIndex = currentMemberCoord.first;
-    int currStart = currentMemberCoord.second;
-
-    TimeSeries currentTimeSeries = this->dataset.getTimeSeries(currIndex, currStart, currStart + this->memberLength);
-    data_t currentDistance = warpedDistance(query, currentTimeSeries, bestSoFarDist);
-
-    if (currentDistance < bestSoFarDist)
+  // Members are compared a batch at a time
+  vector<TimeSeries> batch;
+  vector<const TimeSeries*> batchPointers;
+  vector<member_coord_t> batchCoords;
+  auto compareBatch = [&]() {
+    batchPointers.clear();
+    for (const TimeSeries& member : batch) {
+      batchPointers.push_back(&member);
+    }
+    vector<data_t> distances = distance(query, batchPointers, bestSoFarDist);
+    for (unsigned int k = 0; k < batch.size(); k++)
     {
-      bestSoFarDist = currentDistance;
-      bestSoFarMember = currentMemberCoord;
+      if (distances[k] < bestSoFarDist)
+      {
+        bestSoFarDist = distances[k];
+        bestSoFarMember = batchCoords[k];
+      }
     }
+    batch.clear();
+    batchCoords.clear();
+  };
 
-    currentMemberCoord = this->memberMap[currIndex * this->subTimeSeriesCount + currStart].prev;
+  this->forEachMemberWhile([&](int currIndex, int currStart) -> bool {
+    if (bestSoFarDist < INF && deadline.expired()) {
+      return false;
+    }
+    batch.push_back(this->dataset.getTimeSeries(currIndex, currStart, currStart + this->memberLength));
+    batchCoords.push_back(std::make_pair(currIndex, currStart));
+    if (batch.size() == WARPED_DISTANCE_LANES) {
+      compareBatch();
+    }
+    return true;
+  });
+  if (!batch.empty()) {
+    compareBatch();
   }
 
   int bestIndex = bestSoFarMember.first;
@@ -66,22 +126,115 @@ candidate_time_series_t Group::getBestMatch(const TimeSeries& query, const dist_
   return best;
 }
 
-vector<TimeSeries> Group::getMembers() const
+candidate_time_series_t Group::getBestMatchAcrossLengths(const TimeSeries& query, const vector<int>& lengths,
+                                                         const Deadline& deadline) const
 {
-  vector<TimeSeries> members;
-  member_coord_t currentMemberCoord = this->lastMemberCoord;
-  while (currentMemberCoord.first != -1)
-  {
-    int currIndex = currentMemberCoord.first;
-    int currStart = currentMemberCoord.second;
+  data_t bestSoFarDist = INF;
+  member_coord_t bestSoFarMember;
+  int bestSoFarLength = this->memberLength;
+  int itemLength = this->dataset.getItemLength();
+  vector<int> fitting;
+
+  this->forEachMemberWhile([&](int currIndex, int currStart) -> bool {
+    if (bestSoFarDist < INF && deadline.expired()) {
+      return false;
+    }
+    fitting.clear();
+    int longest = 0;
+    for (int length : lengths)
+    {
+      if (currStart + length <= itemLength) {
+        fitting.push_back(length);
+        longest = std::max(longest, length);
+      }
+    }
+    TimeSeries currentTimeSeries = this->dataset.getTimeSeries(currIndex, currStart, currStart + longest);
+    vector<data_t> distances = warpedDistancePrefixes(query, currentTimeSeries, fitting, bestSoFarDist);
+
+    for (unsigned int k = 0; k < fitting.size(); k++)
+    {
+      if (distances[k] < bestSoFarDist)
+      {
+        bestSoFarDist = distances[k];
+        bestSoFarMember = std::make_pair(currIndex, currStart);
+        bestSoFarLength = fitting[k];
+      }
+    }
+    return true;
+  });
 
+  int bestIndex = bestSoFarMember.first;
+  int bestStart = bestSoFarMember.second;
+  TimeSeries bestTimeSeries = this->dataset.getTimeSeries(bestIndex, bestStart, bestStart + bestSoFarLength);
+  return candidate_time_series_t(bestTimeSeries, bestSoFarDist);
+}
+
+candidate_time_series_t Group::getBestMatch(const TimeSeries& query, const dist_t distance,
+                                            data_t centroidDist, data_t dropout) const
+{
+  data_t bestSoFarDist = dropout;
+  member_coord_t bestSoFarMember(-1, -1);
+  auto visit = [&](int currIndex, int currStart) {
     TimeSeries currentTimeSeries = this->dataset.getTimeSeries(currIndex, currStart, currStart + this->memberLength);
-    members.push_back(currentTimeSeries);
-    currentMemberCoord = this->memberMap[currIndex * this->subTimeSeriesCount + currStart].prev;
+    data_t currentDistance = distance(query, currentTimeSeries, bestSoFarDist);
+    if (currentDistance < bestSoFarDist)
+    {
+      bestSoFarDist = currentDistance;
+      bestSoFarMember = std::make_pair(currIndex, currStart);
+    }
+  };
+
+  if (this->frozenDistances)
+  {
+    // Members are sorted by their distance to the centroid, so the scan goes
+    // outward from d(q, c), closest bound first, until both bounds reach the
+    // best distance so far
+    int hi = std::lower_bound(this->frozenDistances, this->frozenDistances + this->count, centroidDist)
+             - this->frozenDistances;
+    int lo = hi - 1;
+    while (true)
+    {
+      data_t loBound = lo >= 0 ? centroidDist - this->frozenDistances[lo] : INF;
+      data_t hiBound = hi < this->count ? this->frozenDistances[hi] - centroidDist : INF;
+      int next = loBound <= hiBound ? lo-- : hi++;
+      if (std::min(loBound, hiBound) >= bestSoFarDist) {
+        break;
+      }
+      visit(this->frozenMembers[next] / this->subTimeSeriesCount, this->frozenMembers[next] % this->subTimeSeriesCount);
+    }
   }
+  else {
+    this->forEachMember(visit);
+  }
+
+  if (bestSoFarMember.first < 0) {
+    return candidate_time_series_t(TimeSeries(0), dropout);
+  }
+  int bestIndex = bestSoFarMember.first;
+  int bestStart = bestSoFarMember.second;
+  return candidate_time_series_t(
+    this->dataset.getTimeSeries(bestIndex, bestStart, bestStart + this->memberLength), bestSoFarDist);
+}
+
+vector<TimeSeries> Group::getMembers() const
+{
+  vector<TimeSeries> members;
+  this->forEachMember([&](int currIndex, int currStart) {
+    members.push_back(this->dataset.getTimeSeries(currIndex, currStart, currStart + this->memberLength));
+  });
   return members;
 }
 
+vector<member_coord_t> Group::getMemberCoords() const
+{
+  vector<member_coord_t> coords;
+  coords.reserve(this->count);
+  this->forEachMember([&](int currIndex, int currStart) {
+    coords.push_back(std::make_pair(currIndex, currStart));
+  });
+  return coords;
+}
+
 void Group::saveGroup(ofstream &fout) const
 {
   // Group count
@@ -89,14 +242,9 @@ void Group::saveGroup(ofstream &fout) const
   // Members in the group, represented by <index, start> pairs
   this->centroid.printData(fout); fout << endl;
   fout << this->count << " ";
-  member_coord_t currentMemberCoord = this->lastMemberCoord;
-  while (currentMemberCoord.first != -1)
-  {
-    int currIndex = currentMemberCoord.first;
-    int currStart = currentMemberCoord.second;
+  this->forEachMember([&](int currIndex, int currStart) {
     fout << currIndex << " " << currStart << " ";
-    currentMemberCoord = this->memberMap[currIndex * this->subTimeSeriesCount + currStart].prev;    
-  }
+  });
   fout << endl;
 }
 
@@ -104,6 +252,7 @@ void Group::loadGroup(ifstream &fin)
 {
   int cnt;
   this->centroid = TimeSeries(this->memberLength);
+  this->centroidCoord = std::make_pair(-1, -1);
 
   for (int i = 0; i < this->memberLength; i++) {
     fin >> this->centroid[i];
@@ -117,4 +266,10 @@ void Group::loadGroup(ifstream &fin)
   }
 }
 
+void Group::loadGroup(const TimeSeries& centroid, const uint32_t* members, int count)
+{
+  this->setCentroid(centroid);
+  this->setMembers(members, count);
+}
+
 } // namespace onex
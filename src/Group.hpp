@@ -6,8 +6,11 @@
 #include "TimeSeries.hpp"   // INF
 #include "TimeSeriesSet.hpp"
 #include "distance/Distance.hpp"
+#include "Deadline.hpp"
 
+#include <cstdint>
 #include <fstream>
+#include <vector>
 
 namespace onex {
 
@@ -74,26 +77,87 @@ public:
     subTimeSeriesCount(subTimeSeriesCount),
     dataset(dataset),
     memberMap(memberMap),
-    centroid(memberLength),
+    centroid(nullptr, 0),
+    centroidCoord(std::make_pair(-1, -1)),
     lastMemberCoord(std::make_pair(-1, -1)),
-    count(0) {}
+    count(0),
+    frozenMembers(nullptr),
+    frozenDistances(nullptr),
+    radius(INF) {}
 
   /**
    *  @brief adds a member to the group
    *
    *  @param seq which sequence the member is from
    *  @param start where the member starts in the data
+   *
+   *  @throw OnexException if the group is frozen
    */
   void addMember(int index, int start);
 
   /**
-   *  @brief set the centroid of the group
+   *  @brief freezes the group so that its members are read from a packed array
+   *         instead of the member map
+   *
+   *  The array is owned by the caller and must outlive the group. No member
+   *  can be added to a frozen group.
+   *
+   *  @param members members packed as index * subTimeSeriesCount + start
+   *  @param count number of members
+   */
+  void setMembers(const uint32_t* members, int count);
+
+  /**
+   *  @brief sets the distance between the centroid and each member of a
+   *         frozen group, in the order of the packed members
+   *
+   *  The packed members must be sorted by these distances. The array is
+   *  owned by the caller and must outlive the group. It is cleared by
+   *  setMembers.
+   *
+   *  @param distances the distances, measured by a metric
+   */
+  void setMemberDistances(const data_t* distances) { this->frozenDistances = distances; }
+
+  /**
+   *  @return true if the group has been frozen by setMembers
+   */
+  bool isFrozen(void) const { return this->frozenMembers != nullptr; }
+
+  /**
+   *  @brief set the centroid of the group to a sub-sequence of the dataset
+   *
+   *  The centroid refers to the values in the dataset instead of copying them.
    *
    *  @param index index of sequence the centroid is from
    *  @param start where the centroid starts in the data
    */
   void setCentroid(int index, int start);
 
+  /**
+   *  @brief set the centroid of the group to a copy of the given values
+   *
+   *  @param values values of the centroid, which may be the current centroid
+   */
+  void setCentroid(const TimeSeries& values);
+
+  /**
+   *  @brief set the centroid of the group to the mean of its members
+   *
+   *  The centroid owns its values.
+   *
+   *  @param sum sum of the members
+   *  @param count number of members in the sum
+   */
+  void setMeanCentroid(const TimeSeries& sum, int count);
+
+  /**
+   *  @brief gets the coordinate of the centroid in the dataset
+   *
+   *  @return the coordinate, or (-1, -1) if the centroid owns its values
+   */
+  member_coord_t getCentroidCoord() const { return this->centroidCoord; }
+
   /**
    *  @brief gets the centroid of the group
    *
@@ -104,6 +168,13 @@ public:
     return this->centroid;
   }
 
+  /**
+   *  @brief gets the position of the group among the groups of its length
+   */
+  int getIndex(void) const { return this->groupIndex; }
+
+  void setIndex(int groupIndex) { this->groupIndex = groupIndex; }
+
   /**
    *  @brief gets the length of each sequence in the group
    *
@@ -118,6 +189,27 @@ public:
    */
   int getCount(void) const { return this->count;  }
 
+  /**
+   *  @brief gets the largest distance between the centroid and a member, as
+   *         measured by the distance used for grouping
+   *
+   *  @return the radius, or INF if it is not known
+   */
+  data_t getRadius(void) const { return this->radius; }
+
+  void setRadius(data_t radius) { this->radius = radius; }
+
+  /**
+   *  @brief gets the number of bytes used by this group, including its
+   *         centroid and the Keogh envelope cached for it
+   *
+   *  Members are stored by the LocalLengthGroupSpace and are not counted.
+   */
+  size_t getMemoryUsage(void) const
+  {
+    return sizeof(*this) + this->centroid.getMemoryUsage();
+  }
+
   /**
    *  @brief returns the distance between the centroid and the query
    *
@@ -133,6 +225,51 @@ public:
    */
   candidate_time_series_t getBestMatch(const TimeSeries& query, const dist_t distance) const;
 
+  /**
+   *  @brief gets the best match of a query in this group, or the best one
+   *         found before the deadline expires
+   *
+   *  The members are compared a batch at a time with the given distance,
+   *  e.g. cascadeDistanceBatch. At least one member is always compared with
+   *  the query.
+   */
+  candidate_time_series_t getBestMatch(const TimeSeries& query, const batch_dist_t& distance,
+                                       const Deadline& deadline) const;
+
+  /**
+   *  @brief gets the best match of a query among the sub-sequences of several
+   *         lengths that start where a member of this group starts
+   *
+   *  The distances of all lengths from one start are read off a single
+   *  warped distance computation, see warpedDistancePrefixes. At least one
+   *  member is always compared with the query.
+   *
+   *  @param query the query
+   *  @param lengths the lengths. Those that do not fit from a start are skipped
+   *  @param deadline the scan stops when it expires
+   *  @return the best match, of any of the lengths
+   */
+  candidate_time_series_t getBestMatchAcrossLengths(const TimeSeries& query, const std::vector<int>& lengths,
+                                                    const Deadline& deadline) const;
+
+  /**
+   *  @brief gets the best match of a query in this group using a metric
+   *
+   *  By the triangle inequality, a member m cannot be closer to the query q
+   *  than |d(q, c) - d(m, c)|. If the member distances are set, members are
+   *  visited outward from d(q, c) in the order of this bound, and the scan
+   *  stops as soon as it reaches the best distance so far.
+   *
+   *  @param query the query
+   *  @param distance a metric, the one the member distances are measured with
+   *  @param centroidDist distance between the query and the centroid
+   *  @param dropout only members closer than this are returned
+   *  @return the best match, or an empty time series at distance dropout if
+   *          no member is closer than dropout
+   */
+  candidate_time_series_t getBestMatch(const TimeSeries& query, const dist_t distance,
+                                       data_t centroidDist, data_t dropout) const;
+
   /**
    *  @brief gets all the members in a group
    *
@@ -140,10 +277,74 @@ public:
    */
   std::vector<TimeSeries> getMembers() const;
 
+  /**
+   *  @brief gets the coordinates of all members
+   *
+   *  Members of a frozen group are in the order of the packed array. Otherwise
+   *  they are in the order they were added.
+   */
+  std::vector<member_coord_t> getMemberCoords() const;
+
   void saveGroup(std::ofstream &fout) const;
   void loadGroup(std::ifstream &fin);
 
+  /**
+   *  @brief loads a group from the arrays of a binary group file
+   *
+   *  The group is frozen with the given members, see setMembers.
+   *
+   *  @param centroid values of the centroid, which are copied
+   *  @param members members packed as index * subTimeSeriesCount + start
+   *  @param count number of members
+   */
+  void loadGroup(const TimeSeries& centroid, const uint32_t* members, int count);
+
 private:
+  /**
+   *  @brief calls f(index, start) for every member, see getMemberCoords for the order
+   */
+  template <typename F>
+  void forEachMember(F f) const
+  {
+    this->forEachMemberWhile([&f](int index, int start) -> bool {
+      f(index, start);
+      return true;
+    });
+  }
+
+  /**
+   *  @brief calls f(index, start) for the members in the order of
+   *         forEachMember, until f returns false
+   */
+  template <typename F>
+  void forEachMemberWhile(F f) const
+  {
+    if (this->frozenMembers)
+    {
+      for (int i = 0; i < this->count; i++) {
+        if (!f(this->frozenMembers[i] / this->subTimeSeriesCount, this->frozenMembers[i] % this->subTimeSeriesCount)) {
+          return;
+        }
+      }
+      return;
+    }
+    // The linked list goes from the last added member to the first one
+    std::vector<member_coord_t> coords;
+    coords.reserve(this->count);
+    member_coord_t currentMemberCoord = this->lastMemberCoord;
+    while (currentMemberCoord.first != -1)
+    {
+      coords.push_back(currentMemberCoord);
+      currentMemberCoord = this->memberMap[currentMemberCoord.first * this->subTimeSeriesCount +
+                                           currentMemberCoord.second].prev;
+    }
+    for (int i = coords.size() - 1; i >= 0; i--) {
+      if (!f(coords[i].first, coords[i].second)) {
+        return;
+      }
+    }
+  }
+
   const TimeSeriesSet& dataset;
   std::vector<group_membership_t>& memberMap;
 
@@ -154,8 +355,12 @@ private:
   int memberLength;
   int subTimeSeriesCount;
   int count;
+  const uint32_t* frozenMembers;
+  const data_t* frozenDistances;
 
   TimeSeries centroid;
+  member_coord_t centroidCoord;
+  data_t radius;
 };
 
 } // namespace onex
@@ -0,0 +1,116 @@
+#include "GroupFile.hpp"
+#include "Exception.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+
+// Blocks are decoded on one thread below this number
+#define MIN_PARALLEL_BLOCKS 64
+
+using std::vector;
+
+namespace onex {
+
+void writeVarint(vector<uint8_t>& bytes, uint32_t value)
+{
+  while (value >= 0x80)
+  {
+    bytes.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  bytes.push_back((uint8_t)value);
+}
+
+uint32_t readVarint(const uint8_t*& p, const uint8_t* end)
+{
+  uint64_t value = 0;
+  for (int shift = 0; shift < 35; shift += 7)
+  {
+    if (p == end) {
+      break;
+    }
+    uint8_t byte = *p++;
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+    {
+      if (value > UINT32_MAX) {
+        break;
+      }
+      return (uint32_t)value;
+    }
+  }
+  throw OnexException("Group file is corrupted");
+}
+
+void encodeMembers(const vector<uint64_t>& memberOffsets,
+                   const vector<uint32_t>& members,
+                   vector<uint64_t>& blockOffsets,
+                   vector<uint8_t>& bytes)
+{
+  bytes.clear();
+  blockOffsets.clear();
+
+  unsigned int group = 0;
+  for (uint64_t i = 0; i < members.size(); i++)
+  {
+    bool blockStart = i % GROUP_FILE_MEMBER_BLOCK_SIZE == 0;
+    if (blockStart) {
+      blockOffsets.push_back(bytes.size());
+    }
+    while (memberOffsets[group + 1] <= i) {
+      group++;
+    }
+    if (blockStart || i == memberOffsets[group]) {
+      writeVarint(bytes, members[i]);
+    }
+    else {
+      writeVarint(bytes, members[i] - members[i - 1]);
+    }
+  }
+  blockOffsets.push_back(bytes.size());
+}
+
+void decodeMembers(const uint64_t* memberOffsets, uint64_t groupCount,
+                   const uint64_t* blockOffsets, const uint8_t* bytes,
+                   uint32_t* members, uint64_t memberCount)
+{
+  int blockCount = (int)getMemberBlockCount(memberCount);
+  for (int k = 0; k < blockCount; k++)
+  {
+    if (blockOffsets[k] > blockOffsets[k + 1])
+    {
+      throw OnexException("Group file is corrupted");
+    }
+  }
+
+  parallelFor(blockCount, blockCount >= MIN_PARALLEL_BLOCKS ? 0 : 1, [&](int k) {
+    uint64_t first = (uint64_t)k * GROUP_FILE_MEMBER_BLOCK_SIZE;
+    uint64_t last = std::min<uint64_t>(first + GROUP_FILE_MEMBER_BLOCK_SIZE, memberCount);
+    const uint8_t* p = bytes + blockOffsets[k];
+    const uint8_t* end = bytes + blockOffsets[k + 1];
+
+    // Group that the first member of the block belongs to
+    uint64_t group = std::upper_bound(memberOffsets, memberOffsets + groupCount + 1, first)
+                     - memberOffsets - 1;
+    uint64_t value = 0;
+    for (uint64_t i = first; i < last; i++)
+    {
+      while (memberOffsets[group + 1] <= i) {
+        group++;
+      }
+      uint32_t v = readVarint(p, end);
+      value = (i == first || i == memberOffsets[group]) ? v : value + v;
+      if (value > UINT32_MAX)
+      {
+        throw OnexException("Group file is corrupted");
+      }
+      members[i] = (uint32_t)value;
+    }
+    if (p != end)
+    {
+      throw OnexException("Group file is corrupted");
+    }
+  });
+}
+
+} // namespace onex
@@ -0,0 +1,119 @@
+#ifndef GROUP_FILE_H
+#define GROUP_FILE_H
+
+#include <cstdint>
+#include <vector>
+
+// Version 1 is the text format and version 2 the binary format described in
+// src/README.md. New group files are written in the latest version.
+#define GROUP_FILE_TEXT_VERSION 1
+#define GROUP_FILE_VERSION 2
+
+#define GROUP_FILE_MAGIC "ONEXGRPS"
+
+// Flags of a binary group file
+#define GROUP_FILE_COMPRESSED_MEMBERS 1
+#define GROUP_FILE_CENTROID_REFS 2
+#define GROUP_FILE_RADII 4
+#define GROUP_FILE_MEAN_CENTROIDS 8
+#define GROUP_FILE_SUPPORTED_FLAGS (GROUP_FILE_COMPRESSED_MEMBERS | GROUP_FILE_CENTROID_REFS | \
+                                    GROUP_FILE_RADII | GROUP_FILE_MEAN_CENTROIDS)
+
+// Reference of a centroid that is not a sub-sequence of the dataset
+#define GROUP_FILE_NO_CENTROID_REF UINT32_MAX
+
+// Number of members in a block of compressed members
+#define GROUP_FILE_MEMBER_BLOCK_SIZE 256
+
+namespace onex {
+
+/**
+ *  @brief header at the beginning of a binary group file
+ */
+struct group_file_header_t
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t valueSize;
+  uint64_t itemCount;
+  uint64_t itemLength;
+  double threshold;
+  uint32_t flags;
+  uint32_t reserved;
+};
+
+/**
+ *  @brief header of the groups of all lengths, followed by a table with the
+ *         offset of the section of each length from lenFrom to lenTo - 1
+ */
+struct group_space_header_t
+{
+  uint32_t lenFrom;
+  uint32_t lenTo;
+  char distance[24];
+};
+
+/**
+ *  @brief header of the section of one length, followed by the centroids,
+ *         the offsets of the members of each group and the members
+ */
+struct group_length_header_t
+{
+  uint64_t groupCount;
+  uint64_t memberCount;
+};
+
+static_assert(sizeof(group_file_header_t) == 48 && sizeof(group_space_header_t) == 32 &&
+              sizeof(group_length_header_t) == 16,
+              "Headers of a group file must not contain padding");
+
+/**
+ *  @brief compresses the members of all groups of a length
+ *
+ *  The members of each group must be sorted. They are stored as the
+ *  differences between consecutive members, written as variable-length
+ *  integers of 7 bits per byte. The members are split into blocks of
+ *  GROUP_FILE_MEMBER_BLOCK_SIZE, and the first member of a block or of a
+ *  group is stored as is, so that each block can be decoded on its own.
+ *
+ *  @param memberOffsets members of group g are members[memberOffsets[g]] to
+ *         members[memberOffsets[g + 1] - 1]
+ *  @param members the members of all groups
+ *  @param blockOffsets (output) offset of each block in bytes, followed by
+ *         the total number of bytes
+ *  @param bytes (output) the compressed members
+ */
+void encodeMembers(const std::vector<uint64_t>& memberOffsets,
+                   const std::vector<uint32_t>& members,
+                   std::vector<uint64_t>& blockOffsets,
+                   std::vector<uint8_t>& bytes);
+
+/**
+ *  @brief decompresses the members written by encodeMembers
+ *
+ *  Blocks are decoded in parallel when there are many of them.
+ *
+ *  @param memberOffsets member offsets of the groups
+ *  @param groupCount number of groups
+ *  @param blockOffsets offsets of the blocks, followed by the total number of bytes
+ *  @param bytes the compressed members
+ *  @param members (output) the members. Must have room for memberCount values
+ *  @param memberCount number of members
+ *
+ *  @throw OnexException if the compressed members are corrupted
+ */
+void decodeMembers(const uint64_t* memberOffsets, uint64_t groupCount,
+                   const uint64_t* blockOffsets, const uint8_t* bytes,
+                   uint32_t* members, uint64_t memberCount);
+
+/**
+ *  @brief gets the number of blocks of compressed members
+ */
+inline uint64_t getMemberBlockCount(uint64_t memberCount)
+{
+  return (memberCount + GROUP_FILE_MEMBER_BLOCK_SIZE - 1) / GROUP_FILE_MEMBER_BLOCK_SIZE;
+}
+
+} // namespace onex
+
+#endif // GROUP_FILE_H
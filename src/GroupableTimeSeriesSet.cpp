@@ -1,9 +1,13 @@
 #include "GroupableTimeSeriesSet.hpp"
 #include "GlobalGroupSpace.hpp"
 #include "Exception.hpp"
+#include "BinaryFile.hpp"
+#include "MappedFile.hpp"
 #include "distance/Distance.hpp"
 #include <iostream>
 
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 
 using std::ofstream;
@@ -18,7 +22,8 @@ GroupableTimeSeriesSet::~GroupableTimeSeriesSet()
   this->reset();
 }
 
-int GroupableTimeSeriesSet::groupAllLengths(const std::string& distance_name, data_t threshold)
+int GroupableTimeSeriesSet::groupAllLengths(const std::string& distance_name, data_t threshold, int numThreads,
+                                            group_order_t order, bool meanCentroids)
 {
   if (!this->isLoaded())
   {
@@ -29,11 +34,47 @@ int GroupableTimeSeriesSet::groupAllLengths(const std::string& distance_name, da
   reset();
 
   this->groupsAllLengthSet = new GlobalGroupSpace(*this);
-  int cntGroups = this->groupsAllLengthSet->group(distance_name, threshold);
+  int cntGroups = this->groupsAllLengthSet->group(distance_name, threshold, numThreads, order, meanCentroids);
   this->threshold = threshold;
   return cntGroups;
 }
 
+auto_group_result_t GroupableTimeSeriesSet::groupAllLengthsWithBudget(const std::string& distance_name,
+                                                                      int maxGroupCount, size_t maxMemoryUsage,
+                                                                      bool dropSingletons,
+                                                                      int sampleSize, int sampleLengths)
+{
+  if (!this->isLoaded())
+  {
+    throw OnexException("No data to group");
+  }
+
+  auto_group_result_t result;
+  result.predicted = GlobalGroupSpace(*this).selectThreshold(distance_name, maxGroupCount, maxMemoryUsage,
+                                                             sampleSize, sampleLengths, 0);
+  result.groupCount = this->groupAllLengths(distance_name, result.predicted.threshold);
+  result.memoryUsage = this->groupsAllLengthSet->getMemoryUsage();
+  result.droppedGroupCount = 0;
+
+  bool overBudget = (maxGroupCount > 0 && result.groupCount > maxGroupCount) ||
+                    (maxMemoryUsage > 0 && result.memoryUsage > maxMemoryUsage);
+  if (dropSingletons && overBudget)
+  {
+    result.droppedGroupCount = this->groupsAllLengthSet->dropSingletonGroups();
+    result.groupCount -= result.droppedGroupCount;
+    result.memoryUsage = this->groupsAllLengthSet->getMemoryUsage();
+  }
+  return result;
+}
+
+refine_result_t GroupableTimeSeriesSet::refineGroups(int iterations, int minGroupSize, int numThreads)
+{
+  if (!this->isGrouped()) {
+    throw OnexException("No group found");
+  }
+  return this->groupsAllLengthSet->refine(this->threshold, iterations, minGroupSize, numThreads);
+}
+
 bool GroupableTimeSeriesSet::isGrouped() const
 {
   return this->groupsAllLengthSet != nullptr;
@@ -45,26 +86,123 @@ void GroupableTimeSeriesSet::reset()
   this->groupsAllLengthSet = nullptr;
 }
 
-void GroupableTimeSeriesSet::saveGroups(const string& path, bool groupSizeOnly) const
+void GroupableTimeSeriesSet::saveGroups(const string& path, bool groupSizeOnly, int version) const
 {
   if (!this->isGrouped()) {
     throw OnexException("No group found");
   }
+  if (version != GROUP_FILE_TEXT_VERSION && version != GROUP_FILE_VERSION) {
+    throw OnexException("Unsupported group file version");
+  }
 
-  ofstream fout(path);
-  if (fout)
+  // Groups loaded lazily may still be read from the file being replaced, so
+  // the new file is written next to it and renamed when complete
+  string tempPath = path + ".tmp";
+  try
   {
-    // Version of the file format, the threshold and the required dataset dimensions
-    fout << GROUP_FILE_VERSION << " " 
-         << this->threshold << " "
-         << this->getItemCount() << " "
-         << this->getItemLength() << endl;
-    this->groupsAllLengthSet->saveGroups(fout, groupSizeOnly);
+    if (version == GROUP_FILE_TEXT_VERSION || groupSizeOnly)
+    {
+      ofstream fout(tempPath);
+      if (fout)
+      {
+        // Version of the file format, the threshold and the required dataset dimensions
+        fout << GROUP_FILE_TEXT_VERSION << " "
+             << this->threshold << " "
+             << this->getItemCount() << " "
+             << this->getItemLength() << endl;
+        this->groupsAllLengthSet->saveGroups(fout, groupSizeOnly);
+      }
+      else
+      {
+        throw OnexException("Cannot open file");
+      }
+    }
+    else
+    {
+      ofstream fout(tempPath, std::ios::binary);
+      if (!fout)
+      {
+        throw OnexException("Cannot open file");
+      }
+      this->saveGroupsBinary(fout);
+    }
   }
-  else
+  catch (...)
   {
-    throw OnexException("Cannot open file");
+    std::remove(tempPath.c_str());
+    throw;
+  }
+
+  if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+  {
+    std::remove(tempPath.c_str());
+    throw OnexException("Cannot replace " + path);
+  }
+}
+
+void GroupableTimeSeriesSet::saveGroupsBinary(ofstream& fout) const
+{
+  group_file_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, GROUP_FILE_MAGIC, sizeof(header.magic));
+  header.version = GROUP_FILE_VERSION;
+  header.valueSize = sizeof(data_t);
+  header.itemCount = this->getItemCount();
+  header.itemLength = this->getItemLength();
+  header.threshold = this->threshold;
+  header.flags = GROUP_FILE_COMPRESSED_MEMBERS | GROUP_FILE_CENTROID_REFS | GROUP_FILE_RADII;
+  if (this->groupsAllLengthSet->hasMeanCentroids()) {
+    header.flags |= GROUP_FILE_MEAN_CENTROIDS;
+  }
+  fout.write((const char*)&header, sizeof(header));
+  this->groupsAllLengthSet->saveGroupsBinary(fout);
+  fout.close();
+  if (fout.fail())
+  {
+    throw OnexException("Error while writing group file");
+  }
+}
+
+void GroupableTimeSeriesSet::setGroupMemoryLimit(size_t bytes)
+{
+  this->groupMemoryLimit = bytes;
+  if (this->groupsAllLengthSet) {
+    this->groupsAllLengthSet->setMemoryLimit(bytes);
+  }
+}
+
+int GroupableTimeSeriesSet::getLoadedLengthCount() const
+{
+  return this->groupsAllLengthSet ? this->groupsAllLengthSet->getLoadedLengthCount() : 0;
+}
+
+memory_usage_t GroupableTimeSeriesSet::getMemoryUsage() const
+{
+  memory_usage_t usage;
+  usage.dataset = TimeSeriesSet::getMemoryUsage();
+  usage.mapped = this->getMappedMemoryUsage();
+  usage.groups = 0;
+  usage.keoghCache = 0;
+  if (this->groupsAllLengthSet)
+  {
+    usage.groups = this->groupsAllLengthSet->getMemoryUsage();
+    usage.keoghCache = this->groupsAllLengthSet->getKeoghCacheMemoryUsage();
+    usage.mapped += this->groupsAllLengthSet->getMappedMemoryUsage();
+    for (int i = 0; i <= this->getItemLength(); i++) {
+      usage.lengths.push_back(this->groupsAllLengthSet->getMemoryUsage(i));
+    }
+  }
+  return usage;
+}
+
+group_estimate_t GroupableTimeSeriesSet::estimateGroups(const std::string& distance_name, data_t threshold,
+                                                        int sampleLengths) const
+{
+  if (this->data == nullptr)
+  {
+    throw OnexException("No data to group");
   }
+  return GlobalGroupSpace(*this).estimateGroups(distance_name, threshold, sampleLengths);
 }
 
 int GroupableTimeSeriesSet::loadGroups(const string& path)
@@ -73,10 +211,20 @@ int GroupableTimeSeriesSet::loadGroups(const string& path)
   ifstream fin(path);
   if (fin)
   {
+    char magic[8] = {};
+    fin.read(magic, sizeof(magic));
+    if (memcmp(magic, GROUP_FILE_MAGIC, sizeof(magic)) == 0)
+    {
+      fin.close();
+      return this->loadGroupsBinary(path);
+    }
+    fin.clear();
+    fin.seekg(0);
+
     int version, grpItemCount, grpItemLength;
     data_t threshold;
     fin >> version >> threshold >> grpItemCount >> grpItemLength;
-    if (version != GROUP_FILE_VERSION)
+    if (version != GROUP_FILE_TEXT_VERSION)
     {
       throw OnexException("Incompatible file version");
     }
@@ -101,6 +249,60 @@ int GroupableTimeSeriesSet::loadGroups(const string& path)
   return numberOfGroups;
 }
 
+int GroupableTimeSeriesSet::loadGroupsBinary(const string& path)
+{
+  MappedFile* file = new MappedFile(path);
+  group_file_header_t header;
+  try
+  {
+    header = *getSection<group_file_header_t>(*file, 0, 1);
+    if (header.version != GROUP_FILE_VERSION)
+    {
+      throw OnexException("Incompatible file version");
+    }
+    if (header.valueSize != sizeof(float) && header.valueSize != sizeof(double))
+    {
+      throw OnexException("Unsupported value size in group file");
+    }
+    if (header.flags & ~GROUP_FILE_SUPPORTED_FLAGS)
+    {
+      throw OnexException("Group file uses unsupported features");
+    }
+    if (header.itemCount != (uint64_t)this->getItemCount())
+    {
+      throw OnexException("Incompatible item count");
+    }
+    if (header.itemLength != (uint64_t)this->getItemLength())
+    {
+      throw OnexException("Incompatible item length");
+    }
+  }
+  catch (...)
+  {
+    delete file;
+    throw;
+  }
+  cout << "Saved groups are compatible with the dataset" << endl;
+
+  reset();
+  GlobalGroupSpace* groups = new GlobalGroupSpace(*this);
+  int numberOfGroups;
+  try
+  {
+    // The groups of each length are read from the file when they are needed
+    numberOfGroups = groups->loadGroupsBinary(file, sizeof(header), header);
+    groups->setMemoryLimit(this->groupMemoryLimit);
+  }
+  catch (...)
+  {
+    delete groups;
+    throw;
+  }
+  this->threshold = header.threshold;
+  this->groupsAllLengthSet = groups;
+  return numberOfGroups;
+}
+
 candidate_time_series_t GroupableTimeSeriesSet::getBestMatch(const TimeSeries& query) const
 {
   if (this->groupsAllLengthSet) //not nullptr
@@ -110,4 +312,22 @@ candidate_time_series_t GroupableTimeSeriesSet::getBestMatch(const TimeSeries& q
   throw OnexException("Dataset is not grouped");
 }
 
+match_result_t GroupableTimeSeriesSet::getBestMatch(const TimeSeries& query, const match_options_t& options) const
+{
+  if (this->groupsAllLengthSet)
+  {
+    return this->groupsAllLengthSet->getBestMatch(query, options);
+  }
+  throw OnexException("Dataset is not grouped");
+}
+
+candidate_time_series_t GroupableTimeSeriesSet::getBestMatchEuclidean(const TimeSeries& query) const
+{
+  if (this->groupsAllLengthSet)
+  {
+    return this->groupsAllLengthSet->getBestMatchEuclidean(query);
+  }
+  throw OnexException("Dataset is not grouped");
+}
+
 } // namespace onex
\ No newline at end of file
@@ -6,11 +6,33 @@
 #include <vector>
 
 #include "distance/Distance.hpp"
-
-#define GROUP_FILE_VERSION 1
+#include "GroupFile.hpp"
 
 namespace onex {
 
+/**
+ *  @brief the number of bytes used by a dataset and its groups
+ */
+struct memory_usage_t
+{
+  size_t dataset;               // allocated for the dataset
+  size_t groups;                // allocated for the groups of all lengths
+  size_t keoghCache;            // Keogh envelopes of the centroids, part of groups
+  size_t mapped;                // dataset and group files mapped into memory
+  std::vector<size_t> lengths;  // groups of each length, indexed by length
+};
+
+/**
+ *  @brief the outcome of grouping a dataset for a budget
+ */
+struct auto_group_result_t
+{
+  threshold_selection_t predicted;  // the chosen threshold and its prediction
+  int groupCount;                   // actual number of groups
+  size_t memoryUsage;               // actual bytes used by the groups
+  int droppedGroupCount;            // singleton groups removed to meet the budget
+};
+
 /**
  *  @brief a GroupableTimeSeriesSet object is a TimeSeriesSet with grouping
  *         functionalities
@@ -29,10 +51,51 @@ public:
    *
    *  @param distance_name the distance to use for comparing similarity
    *  @param threshold to use for determing the bound of similarity
+   *  @param numThreads number of threads. See GlobalGroupSpace::group
+   *  @param order the order in which sub-sequences are grouped. See GlobalGroupSpace::group
+   *  @param meanCentroids whether centroids are the mean of their members. See
+   *         GlobalGroupSpace::group
    *
    *  @return the number of groups created
    */
-  int groupAllLengths(const std::string& distance_name, data_t threshold);
+  int groupAllLengths(const std::string& distance_name, data_t threshold, int numThreads = 1,
+                      group_order_t order = GROUP_ORDER_START, bool meanCentroids = false);
+
+  /**
+   *  @brief groups the dataset with a threshold chosen to fit a budget
+   *
+   *  The threshold is chosen by GlobalGroupSpace::selectThreshold. If the
+   *  groups still exceed the budget and dropSingletons is set, the groups
+   *  with a single member are removed. Their sub-sequences can then no
+   *  longer be matched.
+   *
+   *  @param distance_name the distance to use for comparing similarity
+   *  @param maxGroupCount maximum number of groups. 0 means no limit
+   *  @param maxMemoryUsage maximum bytes used by the groups. 0 means no limit
+   *  @param dropSingletons whether to remove singleton groups when over budget
+   *  @param sampleSize number of sub-sequences sampled at each length
+   *  @param sampleLengths number of sampled lengths
+   *  @return the chosen threshold with the predicted and actual size
+   *
+   *  @throw OnexException if there is no data or no budget
+   */
+  auto_group_result_t groupAllLengthsWithBudget(const std::string& distance_name,
+                                                int maxGroupCount, size_t maxMemoryUsage,
+                                                bool dropSingletons = false,
+                                                int sampleSize = 1000, int sampleLengths = 4);
+
+  /**
+   *  @brief refines the groups with k-means-style iterations, see
+   *         GlobalGroupSpace::refine
+   *
+   *  @param iterations maximum number of iterations per length
+   *  @param minGroupSize groups with fewer members are merged into others
+   *  @param numThreads number of threads. See getNumberOfThreads
+   *  @return the number of groups and their memory usage before and after
+   *
+   *  @throw OnexException if the dataset is not grouped
+   */
+  refine_result_t refineGroups(int iterations, int minGroupSize, int numThreads = 1);
 
   /**
     *  @brief deletes and clears the groups
@@ -44,8 +107,72 @@ public:
     */
   bool isGrouped() const;
 
-  void saveGroups(const std::string& path, bool groupSizeOnly) const;
+  /**
+   *  @brief saves the groups to a file
+   *
+   *  Version 1 is a text format. Version 2 is a binary format made of
+   *  fixed-width arrays that is loaded by mapping the file into memory. Files
+   *  with only the group sizes are always written in the text format. See
+   *  src/README.md for both formats.
+   *
+   *  @param path path to the group file
+   *  @param groupSizeOnly if true, only the sizes of the groups are saved
+   *  @param version version of the file format
+   *
+   *  @throw OnexException if the dataset is not grouped, the version is not
+   *         supported or the file cannot be written
+   */
+  void saveGroups(const std::string& path, bool groupSizeOnly,
+                  int version = GROUP_FILE_VERSION) const;
+
+  /**
+   *  @brief loads groups saved by saveGroups
+   *
+   *  The version of the file is detected from its content. Binary files are
+   *  mapped into memory and the groups of each length are read the first
+   *  time a query needs them. See setGroupMemoryLimit.
+   *
+   *  @param path path to the group file
+   *  @return number of loaded groups
+   *
+   *  @throw OnexException if the file cannot be read or does not belong to
+   *         a dataset with the same dimensions
+   */
   int loadGroups(const std::string& path);
+
+  /**
+   *  @brief limits the memory used by groups loaded from a binary group file
+   *
+   *  When the limit is exceeded, the lengths used least recently are
+   *  unloaded and read from the file again when they are needed.
+   *
+   *  @param bytes the limit in bytes. 0 means no limit
+   */
+  void setGroupMemoryLimit(size_t bytes);
+
+  /**
+   *  @brief gets the number of lengths whose groups are in memory
+   */
+  int getLoadedLengthCount() const;
+
+  /**
+   *  @brief gets the memory used by the dataset and its groups
+   */
+  memory_usage_t getMemoryUsage() const;
+
+  /**
+   *  @brief predicts the number of groups and their memory usage without
+   *         grouping the dataset. See GlobalGroupSpace::estimateGroups
+   *
+   *  @param distance_name the distance to use for grouping
+   *  @param threshold the threshold to use for grouping
+   *  @param sampleLengths number of lengths that are actually grouped
+   *  @return the prediction
+   *
+   *  @throw OnexException if no data is loaded
+   */
+  group_estimate_t estimateGroups(const std::string& distance_name, data_t threshold,
+                                  int sampleLengths) const;
   
   /**
    * @brief Finds the best matching subsequence in the dataset
@@ -57,9 +184,36 @@ public:
    */
   candidate_time_series_t getBestMatch(const TimeSeries& other) const;
 
+  /**
+   * @brief Finds a subsequence similar to a query, stopping early, see
+   *        GlobalGroupSpace::getBestMatch
+   *
+   * @param query the timeseries to find the match for
+   * @param options limits of the search
+   *
+   * @return the match and how much of the search was done
+   * @throws exception if dataset is not grouped
+   */
+  match_result_t getBestMatch(const TimeSeries& query, const match_options_t& options) const;
+
+  /**
+   * @brief Finds the sub-sequence closest to a query by Euclidean distance
+   *        using the groups, see GlobalGroupSpace::getBestMatchEuclidean
+   *
+   * @param query the timeseries to find the match for
+   *
+   * @return a struct containing the closest TimeSeries and the distance between them
+   * @throws exception if dataset is not grouped with the Euclidean distance
+   */
+  candidate_time_series_t getBestMatchEuclidean(const TimeSeries& query) const;
+
 private:
+  void saveGroupsBinary(std::ofstream& fout) const;
+  int loadGroupsBinary(const std::string& path);
+
   GlobalGroupSpace* groupsAllLengthSet = nullptr;
   data_t threshold;
+  size_t groupMemoryLimit = 0;
 };
 
 } // namespace onex
@@ -5,11 +5,17 @@
 #include <cmath>
 #include <iostream>
 #include <chrono>
+#include <functional>
+#include <random>
+#include <queue>
 
 #include "TimeSeries.hpp"
 #include "Group.hpp"
+#include "GroupFile.hpp"
+#include "BinaryFile.hpp"
 #include "Exception.hpp"
 #include "distance/Distance.hpp"
+#include "Parallel.hpp"
 
 using std::cout;
 using std::ofstream;
@@ -19,13 +25,48 @@ using std::endl;
 #define LOG_EVERY_S 10
 #define LOG_FREQ  5
 
+// Two-phase grouping clusters at least this many sub-sequences, or one in
+// TWO_PHASE_SAMPLE_RATIO of them, before assigning the rest in chunks
+#define TWO_PHASE_MIN_SAMPLE 1024
+#define TWO_PHASE_SAMPLE_RATIO 8
+#define TWO_PHASE_CHUNK_SIZE 1024
+
+// Refinement processes the sub-sequences in chunks of this size in parallel
+#define REFINE_CHUNK_SIZE 1024
+
+// Number of segments of the PAA signature used by GROUP_ORDER_PAA
+#define PAA_SIGNATURE_SEGMENTS 4
+
+// Maximum number of children of a super-group
+#define SUPER_GROUP_FANOUT 16
+
 namespace onex {
 
+/**
+ *  @brief an entry of the best-first search over the super-groups, see
+ *         LocalLengthGroupSpace::getBestGroup and
+ *         LocalLengthGroupSpace::getBestMatchByMetric
+ */
+struct search_entry_t
+{
+  data_t bound;         // lower bound of the distance of everything below
+  int index;            // index of a group or a super-group
+  data_t centroidDist;  // distance between the query and the centroid
+  bool isGroup;
+
+  search_entry_t(data_t bound, int index, data_t centroidDist, bool isGroup)
+    : bound(bound), index(index), centroidDist(centroidDist), isGroup(isGroup) {}
+
+  bool operator>(const search_entry_t& rhs) const
+  {
+    return bound > rhs.bound || (bound == rhs.bound && index > rhs.index);
+  }
+};
+
 LocalLengthGroupSpace::LocalLengthGroupSpace(const TimeSeriesSet& dataset, int length)
- : dataset(dataset), length(length)
+ : dataset(dataset), length(length), centroidLower(0), centroidUpper(0)
 {
   this->subTimeSeriesCount = dataset.getItemLength() - length + 1;
-  this->memberMap = std::vector<group_membership_t>(dataset.getItemCount() * this->subTimeSeriesCount);
 }
 
 LocalLengthGroupSpace::~LocalLengthGroupSpace()
@@ -40,12 +81,167 @@ void LocalLengthGroupSpace::reset()
     delete groups[i];
     groups[i] = nullptr;
   }
-  groups.clear();
+  vector<Group*>().swap(this->groups);
+  vector<group_membership_t>().swap(this->memberMap);
+  vector<uint32_t>().swap(this->memberOffsets);
+  vector<uint32_t>().swap(this->members);
+  vector<data_t>().swap(this->memberDistances);
+  this->dropSuperGroups();
+  this->centroidLower = TimeSeries(0);
+  this->centroidUpper = TimeSeries(0);
 }
 
-std::chrono::time_point<std::chrono::system_clock> _last_time;
+void LocalLengthGroupSpace::dropSuperGroups()
+{
+  vector<super_group_t>().swap(this->superGroups);
+  vector<int>().swap(this->superGroupChildren);
+  vector<TimeSeries>().swap(this->superGroupLower);
+  vector<TimeSeries>().swap(this->superGroupUpper);
+}
+
+uint32_t LocalLengthGroupSpace::getSubsequenceCount() const
+{
+  uint64_t count = (uint64_t)dataset.getItemCount() * this->subTimeSeriesCount;
+  if (count > UINT32_MAX) {
+    throw OnexException("Dataset has too many sub-sequences to be grouped");
+  }
+  return count;
+}
+
+void LocalLengthGroupSpace::allocateMemberMap()
+{
+  this->memberMap.assign(this->getSubsequenceCount(), group_membership_t(-1, std::make_pair(-1, -1)));
+}
+
+void LocalLengthGroupSpace::packMembers(uint32_t subsequenceCount, const std::function<int(uint32_t)>& groupOf)
+{
+  vector<data_t>().swap(this->memberDistances);
+  this->dropSuperGroups();
+  this->centroidLower = TimeSeries(0);
+  this->centroidUpper = TimeSeries(0);
+  this->memberOffsets.assign(this->groups.size() + 1, 0);
+  for (uint32_t i = 0; i < subsequenceCount; i++)
+  {
+    int groupIndex = groupOf(i);
+    if (groupIndex >= 0) {
+      this->memberOffsets[groupIndex + 1]++;
+    }
+  }
+  for (unsigned int i = 0; i < this->groups.size(); i++) {
+    this->memberOffsets[i + 1] += this->memberOffsets[i];
+  }
 
-int LocalLengthGroupSpace::generateGroups(const dist_t pairwiseDistance, data_t threshold)
+  // Scanning in order places the members of each group in dataset order
+  this->members.resize(this->memberOffsets.back());
+  vector<uint32_t> next(this->memberOffsets.begin(), this->memberOffsets.end() - 1);
+  for (uint32_t i = 0; i < subsequenceCount; i++)
+  {
+    int groupIndex = groupOf(i);
+    if (groupIndex >= 0) {
+      this->members[next[groupIndex]++] = i;
+    }
+  }
+
+  for (unsigned int i = 0; i < this->groups.size(); i++) {
+    this->groups[i]->setMembers(this->members.data() + this->memberOffsets[i],
+                                this->memberOffsets[i + 1] - this->memberOffsets[i]);
+  }
+}
+
+void LocalLengthGroupSpace::freeze()
+{
+  this->packMembers(this->memberMap.size(), [this](uint32_t i) {
+    return this->memberMap[i].groupIndex;
+  });
+  vector<group_membership_t>().swap(this->memberMap);
+}
+
+vector<uint32_t> LocalLengthGroupSpace::getGroupingOrder(group_order_t order) const
+{
+  uint32_t subsequenceCount = this->getSubsequenceCount();
+  vector<uint32_t> coords(subsequenceCount);
+  int itemCount = dataset.getItemCount();
+  if (order == GROUP_ORDER_START)
+  {
+    uint32_t k = 0;
+    for (int start = 0; start < this->subTimeSeriesCount; start++) {
+      for (int idx = 0; idx < itemCount; idx++) {
+        coords[k++] = idx * this->subTimeSeriesCount + start;
+      }
+    }
+    return coords;
+  }
+
+  // Segment means of every sub-sequence from the prefix sums of its row
+  int segmentCount = order == GROUP_ORDER_MEAN ? 1 : std::min(PAA_SIGNATURE_SEGMENTS, this->length);
+  vector<double> means((size_t)subsequenceCount * segmentCount);
+  vector<double> prefix(dataset.getItemLength() + 1, 0);
+  for (int idx = 0; idx < itemCount; idx++)
+  {
+    TimeSeries row = dataset.getTimeSeries(idx);
+    for (int i = 0; i < row.getLength(); i++) {
+      prefix[i + 1] = prefix[i] + row[i];
+    }
+    for (int start = 0; start < this->subTimeSeriesCount; start++)
+    {
+      double* m = &means[((size_t)idx * this->subTimeSeriesCount + start) * segmentCount];
+      for (int s = 0; s < segmentCount; s++)
+      {
+        int from = start + s * this->length / segmentCount;
+        int to = start + (s + 1) * this->length / segmentCount;
+        m[s] = (prefix[to] - prefix[from]) / (to - from);
+      }
+    }
+  }
+
+  vector<std::pair<double, uint32_t> > keys(subsequenceCount);
+  if (segmentCount == 1)
+  {
+    for (uint32_t i = 0; i < subsequenceCount; i++) {
+      keys[i] = std::make_pair(means[i], i);
+    }
+  }
+  else
+  {
+    // Each segment mean is quantized to 8 bits, a SAX-like word, and the bits
+    // are interleaved so that no segment dominates the order
+    vector<double> lo(segmentCount, INF), hi(segmentCount, -INF);
+    for (uint32_t i = 0; i < subsequenceCount; i++) {
+      for (int s = 0; s < segmentCount; s++)
+      {
+        lo[s] = std::min(lo[s], means[(size_t)i * segmentCount + s]);
+        hi[s] = std::max(hi[s], means[(size_t)i * segmentCount + s]);
+      }
+    }
+    vector<uint32_t> word(segmentCount);
+    for (uint32_t i = 0; i < subsequenceCount; i++)
+    {
+      for (int s = 0; s < segmentCount; s++)
+      {
+        double range = hi[s] - lo[s];
+        word[s] = range > 0 ? std::min(255.0, (means[(size_t)i * segmentCount + s] - lo[s]) / range * 256) : 0;
+      }
+      uint32_t code = 0;
+      for (int bit = 7; bit >= 0; bit--) {
+        for (int s = 0; s < segmentCount; s++) {
+          code = (code << 1) | ((word[s] >> bit) & 1);
+        }
+      }
+      keys[i] = std::make_pair((double)code, i);
+    }
+  }
+  vector<double>().swap(means);
+
+  std::sort(keys.begin(), keys.end());
+  for (uint32_t i = 0; i < subsequenceCount; i++) {
+    coords[i] = keys[i].second;
+  }
+  return coords;
+}
+
+std::chrono::time_point<std::chrono::system_clock> _last_time;
+int LocalLengthGroupSpace::generateGroups(const dist_t pairwiseDistance, data_t threshold,
+                                          group_order_t order, bool meanCentroids)
 {
   std::chrono::duration<float> elapsed_seconds = std::chrono::system_clock::now() - _last_time;
   bool doLog = false;
@@ -56,48 +252,287 @@ int LocalLengthGroupSpace::generateGroups(const dist_t pairwiseDistance, data_t
   if (doLog) {
     cout << "Processing time series space of length " << this->length << endl;
   }
-  int totalTimeSeries = this->subTimeSeriesCount * dataset.getItemCount();
+  reset();
+  vector<uint32_t> coords = this->getGroupingOrder(order);
+  bool newestFirst = order != GROUP_ORDER_START;
+  if (meanCentroids)
+  {
+    this->generateMeanGroups(pairwiseDistance, threshold, coords, newestFirst);
+    return this->getNumberOfGroups();
+  }
+  this->allocateMemberMap();
+  vector<data_t> radii;
+  int totalTimeSeries = coords.size();
   int counter = 0;
-  for (int start = 0; start < this->subTimeSeriesCount; start++)
+  for (unsigned int k = 0; k < coords.size(); k++)
   {
-    for (int idx = 0; idx < dataset.getItemCount(); idx++)
+    int idx = coords[k] / this->subTimeSeriesCount;
+    int start = coords[k] % this->subTimeSeriesCount;
+    counter++;
+    if (doLog) {
+      if (counter % (totalTimeSeries / LOG_FREQ) == 0) {
+        cout << "  Grouping progress... " << counter << "/" << totalTimeSeries 
+             << " (" << counter*100/totalTimeSeries << "%)" << endl;
+      }
+    }
+
+    TimeSeries query = dataset.getTimeSeries(idx, start, start + this->length);
+
+    data_t bestSoFar = INF;
+    int bestSoFarIndex;
+
+    int groupCount = this->groups.size();
+    for (int j = 0; j < groupCount; j++)
     {
-      counter++;
-      if (doLog) {
-        if (counter % (totalTimeSeries / LOG_FREQ) == 0) {
-          cout << "  Grouping progress... " << counter << "/" << totalTimeSeries 
-               << " (" << counter*100/totalTimeSeries << "%)" << endl;
-        }
+      int i = newestFirst ? groupCount - 1 - j : j;
+      data_t dist = this->groups[i]->distanceFromCentroid(query, pairwiseDistance, bestSoFar);
+      if (dist < bestSoFar)
+      {
+        bestSoFar = dist;
+        bestSoFarIndex = i;
       }
+    }
 
-      TimeSeries query = dataset.getTimeSeries(idx, start, start + this->length);
+    if (bestSoFar > threshold / 2 || this->groups.size() == 0)
+    {
+      bestSoFarIndex = this->groups.size();
+      int newGroupIndex = this->groups.size();
+      this->groups.push_back(new Group(newGroupIndex, this->length, this->subTimeSeriesCount,
+                                       this->dataset, this->memberMap));
+      this->groups[bestSoFarIndex]->setCentroid(idx, start);
+      radii.push_back(0);
+    }
+    else {
+      radii[bestSoFarIndex] = std::max(radii[bestSoFarIndex], bestSoFar);
+    }
 
-      data_t bestSoFar = INF;
-      int bestSoFarIndex;
+    this->groups[bestSoFarIndex]->addMember(idx, start);
+  }
 
-      for (unsigned int i = 0; i < groups.size(); i++)
+  this->freeze();
+  for (unsigned int i = 0; i < this->groups.size(); i++) {
+    this->groups[i]->setRadius(radii[i]);
+  }
+  return this->getNumberOfGroups();
+}
+
+void LocalLengthGroupSpace::generateMeanGroups(const dist_t pairwiseDistance, data_t threshold,
+                                               const vector<uint32_t>& coords, bool newestFirst)
+{
+  uint32_t subsequenceCount = coords.size();
+  auto getSubsequence = [this](uint32_t coord) {
+    int start = coord % this->subTimeSeriesCount;
+    return this->dataset.getTimeSeries(coord / this->subTimeSeriesCount, start, start + this->length);
+  };
+  auto newGroup = [this](uint32_t coord) {
+    Group* group = new Group(this->groups.size(), this->length, this->subTimeSeriesCount,
+                             this->dataset, this->memberMap);
+    this->groups.push_back(group);
+    group->setCentroid(coord / this->subTimeSeriesCount, coord % this->subTimeSeriesCount);
+  };
+
+  // Every sub-sequence joins the closest running mean within threshold / 2
+  vector<int> groupOf(subsequenceCount, -1);
+  vector<TimeSeries> sums;
+  vector<int> counts;
+  for (uint32_t k = 0; k < subsequenceCount; k++)
+  {
+    TimeSeries query = getSubsequence(coords[k]);
+    data_t bestSoFar = threshold / 2;
+    int best = -1;
+    int groupCount = this->groups.size();
+    for (int j = 0; j < groupCount; j++)
+    {
+      int i = newestFirst ? groupCount - 1 - j : j;
+      data_t dist = this->groups[i]->distanceFromCentroid(query, pairwiseDistance, bestSoFar);
+      if (dist <= bestSoFar)
       {
-        data_t dist = this->groups[i]->distanceFromCentroid(query, pairwiseDistance, bestSoFar);
-        if (dist < bestSoFar)
+        bestSoFar = dist;
+        best = i;
+      }
+    }
+
+    if (best < 0)
+    {
+      best = this->groups.size();
+      newGroup(coords[k]);
+      sums.push_back(TimeSeries(this->length));
+      counts.push_back(0);
+    }
+    sums[best] += query;
+    counts[best]++;
+    if (counts[best] > 1) {
+      this->groups[best]->setMeanCentroid(sums[best], counts[best]);
+    }
+    groupOf[coords[k]] = best;
+  }
+  vector<TimeSeries>().swap(sums);
+
+  // The centroids do not change from here on. Members that drifted too far
+  // from theirs move to the closest centroid within threshold / 2 or start a
+  // group whose centroid is themselves
+  vector<data_t> radii(this->groups.size(), 0);
+  vector<int> sizes(counts.begin(), counts.end());
+  for (uint32_t i = 0; i < subsequenceCount; i++)
+  {
+    TimeSeries query = getSubsequence(i);
+    int own = groupOf[i];
+    data_t dist = this->groups[own]->distanceFromCentroid(query, pairwiseDistance, threshold / 2);
+    if (dist <= threshold / 2)
+    {
+      radii[own] = std::max(radii[own], dist);
+      continue;
+    }
+
+    data_t bestSoFar = threshold / 2;
+    int best = -1;
+    for (unsigned int j = 0; j < this->groups.size(); j++)
+    {
+      dist = this->groups[j]->distanceFromCentroid(query, pairwiseDistance, bestSoFar);
+      if (dist <= bestSoFar)
+      {
+        bestSoFar = dist;
+        best = j;
+      }
+    }
+    if (best < 0)
+    {
+      best = this->groups.size();
+      newGroup(i);
+      radii.push_back(0);
+      sizes.push_back(0);
+      bestSoFar = 0;
+    }
+    sizes[own]--;
+    sizes[best]++;
+    radii[best] = std::max(radii[best], bestSoFar);
+    groupOf[i] = best;
+  }
+
+  // Groups left without members are removed
+  vector<Group*> kept;
+  vector<int> newIndex(this->groups.size(), -1);
+  for (unsigned int i = 0; i < this->groups.size(); i++)
+  {
+    if (sizes[i] > 0)
+    {
+      newIndex[i] = kept.size();
+      this->groups[i]->setRadius(radii[i]);
+      kept.push_back(this->groups[i]);
+    }
+    else {
+      delete this->groups[i];
+    }
+  }
+  this->groups.swap(kept);
+  this->packMembers(subsequenceCount, [&](uint32_t i) { return newIndex[groupOf[i]]; });
+}
+
+int LocalLengthGroupSpace::generateGroups(const dist_t pairwiseDistance, data_t threshold, int numThreads)
+{
+  reset();
+  uint32_t subsequenceCount = this->getSubsequenceCount();
+  auto getSubsequence = [this](uint32_t coord) {
+    int start = coord % this->subTimeSeriesCount;
+    return this->dataset.getTimeSeries(coord / this->subTimeSeriesCount, start, start + this->length);
+  };
+
+  // Phase 1: leader clustering of a random sample gives most of the centroids
+  uint32_t sampleSize = std::min<uint32_t>(subsequenceCount,
+    std::max<uint32_t>(TWO_PHASE_MIN_SAMPLE, subsequenceCount / TWO_PHASE_SAMPLE_RATIO));
+  vector<uint32_t> order(subsequenceCount);
+  for (uint32_t i = 0; i < subsequenceCount; i++) {
+    order[i] = i;
+  }
+  std::mt19937 rng(this->length);
+  for (uint32_t i = 0; i < sampleSize; i++) {
+    std::swap(order[i], order[std::uniform_int_distribution<uint32_t>(i, subsequenceCount - 1)(rng)]);
+  }
+
+  vector<uint32_t> centroidCoords;
+  vector<TimeSeries> centroids;
+  for (uint32_t i = 0; i < sampleSize; i++)
+  {
+    TimeSeries query = getSubsequence(order[i]);
+    bool grouped = false;
+    for (unsigned int j = 0; j < centroids.size() && !grouped; j++) {
+      grouped = pairwiseDistance(centroids[j], query, threshold / 2) <= threshold / 2;
+    }
+    if (!grouped)
+    {
+      centroidCoords.push_back(order[i]);
+      centroids.push_back(query);
+    }
+  }
+  vector<uint32_t>().swap(order);
+
+  // Phase 2: every sub-sequence joins its closest centroid within threshold / 2.
+  // Centroids are not changed here, so the sub-sequences are independent
+  vector<int> groupOf(subsequenceCount, -1);
+  vector<data_t> distances(subsequenceCount, 0);
+  int chunkCount = (subsequenceCount + TWO_PHASE_CHUNK_SIZE - 1) / TWO_PHASE_CHUNK_SIZE;
+  parallelFor(chunkCount, numThreads, [&](int chunk) {
+    uint32_t end = std::min<uint64_t>(subsequenceCount, (uint64_t)(chunk + 1) * TWO_PHASE_CHUNK_SIZE);
+    for (uint32_t i = chunk * TWO_PHASE_CHUNK_SIZE; i < end; i++)
+    {
+      TimeSeries query = getSubsequence(i);
+      data_t bestSoFar = threshold / 2;
+      for (unsigned int j = 0; j < centroids.size(); j++)
+      {
+        data_t dist = pairwiseDistance(centroids[j], query, bestSoFar);
+        if (dist <= bestSoFar)
         {
           bestSoFar = dist;
-          bestSoFarIndex = i;
+          groupOf[i] = j;
         }
       }
+      distances[i] = bestSoFar;
+    }
+  });
 
-      if (bestSoFar > threshold / 2 || this->groups.size() == 0)
+  // Phase 3: the sub-sequences far from every centroid are grouped the same
+  // way as generateGroups does, among the centroids they spawn
+  unsigned int sampledCentroids = centroids.size();
+  for (uint32_t i = 0; i < subsequenceCount; i++)
+  {
+    if (groupOf[i] >= 0) {
+      continue;
+    }
+    TimeSeries query = getSubsequence(i);
+    data_t bestSoFar = threshold / 2;
+    for (unsigned int j = sampledCentroids; j < centroids.size(); j++)
+    {
+      data_t dist = pairwiseDistance(centroids[j], query, bestSoFar);
+      if (dist <= bestSoFar)
       {
-        bestSoFarIndex = this->groups.size();
-        int newGroupIndex = this->groups.size();
-        this->groups.push_back(new Group(newGroupIndex, this->length, this->subTimeSeriesCount,
-                                         this->dataset, this->memberMap));
-        this->groups[bestSoFarIndex]->setCentroid(idx, start);
+        bestSoFar = dist;
+        groupOf[i] = j;
       }
-
-      this->groups[bestSoFarIndex]->addMember(idx, start);
+    }
+    distances[i] = bestSoFar;
+    if (groupOf[i] < 0)
+    {
+      groupOf[i] = centroids.size();
+      centroidCoords.push_back(i);
+      centroids.push_back(query);
+      distances[i] = 0;
     }
   }
 
+  for (unsigned int i = 0; i < centroidCoords.size(); i++)
+  {
+    Group* group = new Group(i, this->length, this->subTimeSeriesCount, this->dataset, this->memberMap);
+    this->groups.push_back(group);
+    group->setCentroid(centroidCoords[i] / this->subTimeSeriesCount, centroidCoords[i] % this->subTimeSeriesCount);
+  }
+  vector<data_t> radii(centroidCoords.size(), 0);
+  for (uint32_t i = 0; i < subsequenceCount; i++) {
+    radii[groupOf[i]] = std::max(radii[groupOf[i]], distances[i]);
+  }
+  for (unsigned int i = 0; i < radii.size(); i++) {
+    this->groups[i]->setRadius(radii[i]);
+  }
+  this->packMembers(subsequenceCount, [&groupOf](uint32_t i) { return groupOf[i]; });
   return this->getNumberOfGroups();
 }
 
@@ -106,6 +541,48 @@ int LocalLengthGroupSpace::getNumberOfGroups(void) const
   return this->groups.size();
 }
 
+size_t LocalLengthGroupSpace::getMemoryUsage(void) const
+{
+  size_t bytes = sizeof(*this)
+    + this->memberMap.capacity() * sizeof(group_membership_t)
+    + (this->memberOffsets.capacity() + this->members.capacity()) * sizeof(uint32_t)
+    + this->memberDistances.capacity() * sizeof(data_t)
+    + this->superGroups.capacity() * sizeof(super_group_t)
+    + this->superGroupChildren.capacity() * sizeof(int)
+    + (this->superGroupLower.capacity() + this->superGroupUpper.capacity()) * sizeof(TimeSeries)
+    + this->centroidLower.getMemoryUsage() + this->centroidUpper.getMemoryUsage()
+    + this->groups.capacity() * sizeof(Group*);
+  for (unsigned int i = 0; i < this->superGroupLower.size(); i++) {
+    bytes += this->superGroupLower[i].getMemoryUsage() + this->superGroupUpper[i].getMemoryUsage();
+  }
+  for (unsigned int i = 0; i < this->groups.size(); i++) {
+    bytes += this->groups[i]->getMemoryUsage();
+  }
+  return bytes;
+}
+
+size_t LocalLengthGroupSpace::getKeoghCacheMemoryUsage(void) const
+{
+  size_t bytes = 0;
+  for (unsigned int i = 0; i < this->groups.size(); i++) {
+    bytes += this->groups[i]->getCentroid().getKeoghCacheMemoryUsage();
+  }
+  return bytes;
+}
+
+size_t LocalLengthGroupSpace::estimateMemoryUsage(int itemCount, int itemLength, int length, int groupCount)
+{
+  size_t memberCount = (size_t)itemCount * (itemLength - length + 1);
+  return sizeof(LocalLengthGroupSpace)
+    + (groupCount + 1 + memberCount) * sizeof(uint32_t)
+    + (size_t)groupCount * (sizeof(Group*) + sizeof(Group));
+}
+
+size_t LocalLengthGroupSpace::estimateBuildMemoryUsage(int itemCount, int itemLength, int length)
+{
+  return (size_t)itemCount * (itemLength - length + 1) * sizeof(group_membership_t);
+}
+
 const Group* LocalLengthGroupSpace::getGroup(int idx) const
 {
   if (idx < 0 || idx >= this->getNumberOfGroups()) {
@@ -137,32 +614,770 @@ void LocalLengthGroupSpace::saveGroups(ofstream &fout, bool groupSizeOnly) const
 int LocalLengthGroupSpace::loadGroups(ifstream &fin)
 {
   reset();
+  this->allocateMemberMap();
   int numberOfGroups;
   fin >> numberOfGroups;
   for (unsigned int i = 0; i < numberOfGroups; i++)
   {
     Group* grp = new Group(i, this->length, this->subTimeSeriesCount, this->dataset, this->memberMap);
-    grp->loadGroup(fin);
     this->groups.push_back(grp);
+    grp->loadGroup(fin);
   }
+  this->freeze();
   return numberOfGroups;
 }
 
+void LocalLengthGroupSpace::saveGroupsBinary(ofstream &fout) const
+{
+  group_length_header_t header;
+  header.groupCount = this->groups.size();
+  header.memberCount = this->members.size();
+  fout.write((const char*)&header, sizeof(header));
+
+  // Centroids from the dataset are written as references, followed by the
+  // values of the other centroids
+  vector<uint32_t> centroidRefs(this->groups.size(), GROUP_FILE_NO_CENTROID_REF);
+  for (unsigned int i = 0; i < this->groups.size(); i++)
+  {
+    member_coord_t coord = this->groups[i]->getCentroidCoord();
+    if (coord.first >= 0) {
+      centroidRefs[i] = coord.first * this->subTimeSeriesCount + coord.second;
+    }
+  }
+  fout.write((const char*)centroidRefs.data(), centroidRefs.size() * sizeof(uint32_t));
+  writePadding(fout);
+  for (unsigned int i = 0; i < this->groups.size(); i++)
+  {
+    if (centroidRefs[i] == GROUP_FILE_NO_CENTROID_REF) {
+      fout.write((const char*)&this->groups[i]->getCentroid()[0], this->length * sizeof(data_t));
+    }
+  }
+  writePadding(fout);
+  for (unsigned int i = 0; i < this->groups.size(); i++)
+  {
+    data_t radius = this->groups[i]->getRadius();
+    fout.write((const char*)&radius, sizeof(data_t));
+  }
+  writePadding(fout);
+
+  // Members of group i are at [memberOffsets[i], memberOffsets[i + 1]) of the member array.
+  // They are sorted within each group so that they can be delta coded. Members
+  // sorted by distance to their centroid are put back in dataset order
+  vector<uint64_t> memberOffsets(this->memberOffsets.begin(), this->memberOffsets.end());
+  if (memberOffsets.empty()) {
+    memberOffsets.push_back(0);
+  }
+  fout.write((const char*)memberOffsets.data(), memberOffsets.size() * sizeof(uint64_t));
+
+  vector<uint32_t> sortedMembers;
+  const vector<uint32_t>* members = &this->members;
+  for (unsigned int i = 0; i < this->groups.size(); i++)
+  {
+    if (!std::is_sorted(this->members.begin() + memberOffsets[i], this->members.begin() + memberOffsets[i + 1]))
+    {
+      sortedMembers = this->members;
+      for (unsigned int g = 0; g < this->groups.size(); g++) {
+        std::sort(sortedMembers.begin() + memberOffsets[g], sortedMembers.begin() + memberOffsets[g + 1]);
+      }
+      members = &sortedMembers;
+      break;
+    }
+  }
+
+  vector<uint64_t> blockOffsets;
+  vector<uint8_t> bytes;
+  encodeMembers(memberOffsets, *members, blockOffsets, bytes);
+  fout.write((const char*)blockOffsets.data(), blockOffsets.size() * sizeof(uint64_t));
+  fout.write((const char*)bytes.data(), bytes.size());
+  writePadding(fout);
+}
+
+int LocalLengthGroupSpace::loadGroupsBinary(const MappedFile& file, uint64_t offset,
+                                            const group_file_header_t& fileHeader)
+{
+  int valueSize = fileHeader.valueSize;
+  reset();
+  const group_length_header_t* header = getSection<group_length_header_t>(file, offset, 1);
+  uint64_t groupCount = header->groupCount;
+  uint64_t memberCount = header->memberCount;
+  uint64_t subsequenceCount = (uint64_t)dataset.getItemCount() * this->subTimeSeriesCount;
+  if (groupCount > memberCount || memberCount > subsequenceCount)
+  {
+    throw OnexException("Group file is corrupted");
+  }
+
+  uint64_t pos = offset + sizeof(group_length_header_t);
+  const uint32_t* centroidRefs = nullptr;
+  uint64_t valueCount = groupCount;
+  if (fileHeader.flags & GROUP_FILE_CENTROID_REFS)
+  {
+    centroidRefs = getSection<uint32_t>(file, pos, groupCount);
+    pos = alignOffset(pos + groupCount * sizeof(uint32_t));
+    valueCount = std::count(centroidRefs, centroidRefs + groupCount, GROUP_FILE_NO_CENTROID_REF);
+    for (uint64_t i = 0; i < groupCount; i++)
+    {
+      if (centroidRefs[i] != GROUP_FILE_NO_CENTROID_REF && centroidRefs[i] >= subsequenceCount)
+      {
+        throw OnexException("Group file is corrupted");
+      }
+    }
+  }
+  const char* centroids = getSection<char>(file, pos, valueCount * this->length * valueSize);
+  pos = alignOffset(pos + valueCount * this->length * valueSize);
+  const char* radii = nullptr;
+  if (fileHeader.flags & GROUP_FILE_RADII)
+  {
+    radii = getSection<char>(file, pos, groupCount * valueSize);
+    pos = alignOffset(pos + groupCount * valueSize);
+  }
+  const uint64_t* memberOffsets = getSection<uint64_t>(file, pos, groupCount + 1);
+  pos += (groupCount + 1) * sizeof(uint64_t);
+
+  if (memberOffsets[0] != 0 || memberOffsets[groupCount] != memberCount)
+  {
+    throw OnexException("Group file is corrupted");
+  }
+  for (uint64_t i = 0; i < groupCount; i++)
+  {
+    if (memberOffsets[i] > memberOffsets[i + 1])
+    {
+      throw OnexException("Group file is corrupted");
+    }
+  }
+
+  this->members.resize(memberCount);
+  if (fileHeader.flags & GROUP_FILE_COMPRESSED_MEMBERS)
+  {
+    uint64_t blockCount = getMemberBlockCount(memberCount);
+    const uint64_t* blockOffsets = getSection<uint64_t>(file, pos, blockCount + 1);
+    pos += (blockCount + 1) * sizeof(uint64_t);
+    const uint8_t* bytes = getSection<uint8_t>(file, pos, blockOffsets[blockCount]);
+    decodeMembers(memberOffsets, groupCount, blockOffsets, bytes, this->members.data(), memberCount);
+  }
+  else
+  {
+    // Uncompressed members may be in any order within their group
+    const uint32_t* members = getSection<uint32_t>(file, pos, memberCount);
+    std::copy(members, members + memberCount, this->members.begin());
+    for (uint64_t i = 0; i < groupCount; i++) {
+      std::sort(this->members.begin() + memberOffsets[i], this->members.begin() + memberOffsets[i + 1]);
+    }
+  }
+
+  // Every member is a sub-sequence of this length, in a single group
+  vector<bool> seen(subsequenceCount, false);
+  for (uint64_t i = 0; i < memberCount; i++)
+  {
+    if (this->members[i] >= subsequenceCount || seen[this->members[i]])
+    {
+      throw OnexException("Group file is corrupted");
+    }
+    seen[this->members[i]] = true;
+  }
+  this->memberOffsets.assign(memberOffsets, memberOffsets + groupCount + 1);
+
+  TimeSeries centroid(this->length);
+  for (uint64_t i = 0; i < groupCount; i++)
+  {
+    Group* grp = new Group(i, this->length, this->subTimeSeriesCount, this->dataset, this->memberMap);
+    this->groups.push_back(grp);
+    const uint32_t* groupMembers = this->members.data() + memberOffsets[i];
+    int count = memberOffsets[i + 1] - memberOffsets[i];
+    if (centroidRefs && centroidRefs[i] != GROUP_FILE_NO_CENTROID_REF)
+    {
+      grp->setCentroid(centroidRefs[i] / this->subTimeSeriesCount, centroidRefs[i] % this->subTimeSeriesCount);
+      grp->setMembers(groupMembers, count);
+    }
+    else
+    {
+      readValues(centroids, valueSize, &centroid[0], this->length);
+      centroids += this->length * valueSize;
+      grp->loadGroup(centroid, groupMembers, count);
+    }
+    if (radii)
+    {
+      data_t radius;
+      readValues(radii + i * valueSize, valueSize, &radius, 1);
+      grp->setRadius(radius);
+    }
+  }
+  return groupCount;
+}
+
+int LocalLengthGroupSpace::refineGroups(const dist_t pairwiseDistance, data_t threshold,
+                                        int iterations, int minGroupSize, int numThreads,
+                                        bool& hasMeanCentroids)
+{
+  uint32_t subsequenceCount = this->getSubsequenceCount();
+  auto getSubsequence = [this](uint32_t coord) {
+    int start = coord % this->subTimeSeriesCount;
+    return this->dataset.getTimeSeries(coord / this->subTimeSeriesCount, start, start + this->length);
+  };
+  int chunkCount = (subsequenceCount + REFINE_CHUNK_SIZE - 1) / REFINE_CHUNK_SIZE;
+  auto forEachSubsequence = [&](const std::function<void(uint32_t)>& f) {
+    parallelFor(chunkCount, numThreads, [&](int chunk) {
+      uint32_t end = std::min<uint64_t>(subsequenceCount, (uint64_t)(chunk + 1) * REFINE_CHUNK_SIZE);
+      for (uint32_t i = chunk * REFINE_CHUNK_SIZE; i < end; i++) {
+        f(i);
+      }
+    });
+  };
+
+  // Sub-sequences of dropped groups are not grouped and stay that way
+  vector<int> groupOf(subsequenceCount, -1);
+  vector<TimeSeries> centroids;
+  vector<member_coord_t> centroidCoords;
+  for (unsigned int g = 0; g < this->groups.size(); g++)
+  {
+    for (uint32_t k = this->memberOffsets[g]; k < this->memberOffsets[g + 1]; k++) {
+      groupOf[this->members[k]] = g;
+    }
+    centroids.push_back(this->groups[g]->getCentroid());
+    centroidCoords.push_back(this->groups[g]->getCentroidCoord());
+  }
+
+  vector<int> nearest(subsequenceCount, -1);
+  vector<char> valid(subsequenceCount, 0);
+  for (int iteration = 0; iteration < iterations; iteration++)
+  {
+    int groupCount = centroids.size();
+
+    // Every member moves to its closest centroid. The current one is within
+    // threshold / 2, so the others are compared with an early abandon
+    forEachSubsequence([&](uint32_t i) {
+      nearest[i] = groupOf[i];
+      if (groupOf[i] < 0) {
+        return;
+      }
+      TimeSeries query = getSubsequence(i);
+      data_t bestSoFar = pairwiseDistance(centroids[groupOf[i]], query, INF);
+      for (int j = 0; j < groupCount; j++)
+      {
+        data_t dist = pairwiseDistance(centroids[j], query, bestSoFar);
+        if (dist < bestSoFar)
+        {
+          bestSoFar = dist;
+          nearest[i] = j;
+        }
+      }
+    });
+    uint32_t moved = 0;
+    vector<int> sizes(groupCount, 0);
+    for (uint32_t i = 0; i < subsequenceCount; i++)
+    {
+      if (nearest[i] != groupOf[i]) {
+        moved++;
+      }
+      groupOf[i] = nearest[i];
+      if (groupOf[i] >= 0) {
+        sizes[groupOf[i]]++;
+      }
+    }
+
+    // Members of small groups look for the closest other centroid within threshold / 2
+    forEachSubsequence([&](uint32_t i) {
+      nearest[i] = -1;
+      int own = groupOf[i];
+      if (own < 0 || sizes[own] >= minGroupSize) {
+        return;
+      }
+      TimeSeries query = getSubsequence(i);
+      data_t bestSoFar = threshold / 2;
+      for (int j = 0; j < groupCount; j++)
+      {
+        if (j == own) {
+          continue;
+        }
+        data_t dist = pairwiseDistance(centroids[j], query, bestSoFar);
+        if (dist <= bestSoFar)
+        {
+          bestSoFar = dist;
+          nearest[i] = j;
+        }
+      }
+    });
+
+    // The smallest groups are dissolved first. A group that has been dissolved
+    // cannot take members and one that has taken members cannot be dissolved
+    vector<uint32_t> memberOffsets(groupCount + 1, 0);
+    for (uint32_t i = 0; i < subsequenceCount; i++) {
+      if (groupOf[i] >= 0 && sizes[groupOf[i]] < minGroupSize) {
+        memberOffsets[groupOf[i] + 1]++;
+      }
+    }
+    for (int g = 0; g < groupCount; g++) {
+      memberOffsets[g + 1] += memberOffsets[g];
+    }
+    vector<uint32_t> smallMembers(memberOffsets.back());
+    vector<uint32_t> next(memberOffsets.begin(), memberOffsets.end() - 1);
+    for (uint32_t i = 0; i < subsequenceCount; i++) {
+      if (groupOf[i] >= 0 && sizes[groupOf[i]] < minGroupSize) {
+        smallMembers[next[groupOf[i]]++] = i;
+      }
+    }
+    vector<int> smallGroups;
+    for (int g = 0; g < groupCount; g++) {
+      if (sizes[g] > 0 && sizes[g] < minGroupSize) {
+        smallGroups.push_back(g);
+      }
+    }
+    std::stable_sort(smallGroups.begin(), smallGroups.end(), [&sizes](int a, int b) {
+      return sizes[a] < sizes[b];
+    });
+    vector<char> dissolved(groupCount, 0), received(groupCount, 0);
+    for (int g : smallGroups)
+    {
+      if (received[g]) {
+        continue;
+      }
+      bool canDissolve = true;
+      for (uint32_t k = memberOffsets[g]; k < memberOffsets[g + 1] && canDissolve; k++)
+      {
+        int target = nearest[smallMembers[k]];
+        canDissolve = target >= 0 && !dissolved[target];
+      }
+      if (!canDissolve) {
+        continue;
+      }
+      for (uint32_t k = memberOffsets[g]; k < memberOffsets[g + 1]; k++)
+      {
+        int target = nearest[smallMembers[k]];
+        groupOf[smallMembers[k]] = target;
+        sizes[target]++;
+        received[target] = 1;
+        moved++;
+      }
+      sizes[g] = 0;
+      dissolved[g] = 1;
+    }
+
+    // Each centroid becomes the mean of its members if they are all within threshold / 2 of it
+    vector<TimeSeries> sums(groupCount, TimeSeries(this->length));
+    for (uint32_t i = 0; i < subsequenceCount; i++) {
+      if (groupOf[i] >= 0) {
+        sums[groupOf[i]] += getSubsequence(i);
+      }
+    }
+    vector<TimeSeries> means(groupCount, TimeSeries(this->length));
+    for (int g = 0; g < groupCount; g++) {
+      for (int k = 0; k < this->length && sizes[g] > 0; k++) {
+        means[g][k] = sums[g][k] / sizes[g];
+      }
+    }
+    vector<TimeSeries>().swap(sums);
+    forEachSubsequence([&](uint32_t i) {
+      valid[i] = groupOf[i] < 0 ||
+        pairwiseDistance(means[groupOf[i]], getSubsequence(i), threshold / 2) <= threshold / 2;
+    });
+    vector<char> keepMean(groupCount, 1);
+    for (uint32_t i = 0; i < subsequenceCount; i++) {
+      if (!valid[i]) {
+        keepMean[groupOf[i]] = 0;
+      }
+    }
+
+    // Empty groups are removed
+    vector<TimeSeries> kept;
+    vector<member_coord_t> keptCoords;
+    vector<int> newIndex(groupCount, -1);
+    for (int g = 0; g < groupCount; g++)
+    {
+      if (sizes[g] == 0) {
+        continue;
+      }
+      newIndex[g] = kept.size();
+      if (keepMean[g])
+      {
+        kept.push_back(std::move(means[g]));
+        keptCoords.push_back(std::make_pair(-1, -1));
+      }
+      else
+      {
+        kept.push_back(centroids[g]);
+        keptCoords.push_back(centroidCoords[g]);
+      }
+    }
+    centroids.swap(kept);
+    centroidCoords.swap(keptCoords);
+    for (uint32_t i = 0; i < subsequenceCount; i++) {
+      if (groupOf[i] >= 0) {
+        groupOf[i] = newIndex[groupOf[i]];
+      }
+    }
+
+    if (moved == 0) {
+      break;
+    }
+  }
+  vector<int>().swap(nearest);
+  vector<char>().swap(valid);
+
+  // The groups are rebuilt from the refined centroids
+  vector<data_t> distances(subsequenceCount, 0);
+  forEachSubsequence([&](uint32_t i) {
+    if (groupOf[i] >= 0) {
+      distances[i] = pairwiseDistance(centroids[groupOf[i]], getSubsequence(i), INF);
+    }
+  });
+  vector<data_t> radii(centroids.size(), 0);
+  for (uint32_t i = 0; i < subsequenceCount; i++) {
+    if (groupOf[i] >= 0) {
+      radii[groupOf[i]] = std::max(radii[groupOf[i]], distances[i]);
+    }
+  }
+
+  reset();
+  hasMeanCentroids = false;
+  for (unsigned int g = 0; g < centroids.size(); g++)
+  {
+    Group* group = new Group(g, this->length, this->subTimeSeriesCount, this->dataset, this->memberMap);
+    this->groups.push_back(group);
+    if (centroidCoords[g].first >= 0) {
+      group->setCentroid(centroidCoords[g].first, centroidCoords[g].second);
+    }
+    else {
+      group->setCentroid(centroids[g]);
+      hasMeanCentroids = true;
+    }
+    group->setRadius(radii[g]);
+  }
+  this->packMembers(subsequenceCount, [&groupOf](uint32_t i) { return groupOf[i]; });
+  return this->getNumberOfGroups();
+}
+
+int LocalLengthGroupSpace::dropSingletonGroups()
+{
+  vector<Group*> kept;
+  vector<uint32_t> memberOffsets(1, 0);
+  vector<uint32_t> members;
+  for (unsigned int i = 0; i < this->groups.size(); i++)
+  {
+    if (this->groups[i]->getCount() > 1)
+    {
+      kept.push_back(this->groups[i]);
+      members.insert(members.end(), this->members.begin() + this->memberOffsets[i],
+                     this->members.begin() + this->memberOffsets[i + 1]);
+      memberOffsets.push_back(members.size());
+    }
+    else {
+      delete this->groups[i];
+    }
+  }
+
+  int dropped = this->groups.size() - kept.size();
+  vector<data_t>().swap(this->memberDistances);
+  this->dropSuperGroups();
+  this->groups.swap(kept);
+  this->memberOffsets.swap(memberOffsets);
+  this->members.swap(members);
+  for (unsigned int i = 0; i < this->groups.size(); i++)
+  {
+    this->groups[i]->setIndex(i);
+    this->groups[i]->setMembers(this->members.data() + this->memberOffsets[i], this->groups[i]->getCount());
+  }
+  return dropped;
+}
+
 candidate_group_t LocalLengthGroupSpace::getBestGroup(const TimeSeries& query,
   const dist_t warpedDistance,
   data_t dropout) const
 {
+  batch_dist_t batch = [warpedDistance](const TimeSeries& a, const vector<const TimeSeries*>& b, data_t dropout) {
+    return batchDistance(warpedDistance, a, b, dropout);
+  };
+  int visited;
+  return this->getBestGroup(query, batch, dropout, 0, 0, Deadline(), visited);
+}
+
+candidate_group_t LocalLengthGroupSpace::getBestGroup(const TimeSeries& query,
+  const batch_dist_t& warpedDistance,
+  data_t dropout, data_t epsilon, int maxGroups,
+  const Deadline& deadline, int& visited) const
+{
+  // Without super-groups, every group is a candidate from the start. With
+  // them, the groups of a leaf become candidates once it is reached, and no
+  // centroid below a super-group is closer than the bound of its envelope
+  std::priority_queue<search_entry_t, vector<search_entry_t>, std::greater<search_entry_t> > queue;
+  if (this->superGroups.empty())
+  {
+    for (unsigned int i = 0; i < groups.size(); i++) {
+      queue.push(search_entry_t(endpointLowerBound(groups[i]->getCentroid(), query), i, 0, true));
+    }
+  }
+  else {
+    queue.push(search_entry_t(envelopeLowerBound(query, this->superGroupLower[0], this->superGroupUpper[0]),
+                              0, 0, false));
+  }
+
   data_t bestSoFarDist = dropout;
   const Group* bestSoFarGroup = nullptr;
-  for (unsigned int i = 0; i < groups.size(); i++) {
-    data_t dist = groups[i]->distanceFromCentroid(query, warpedDistance, bestSoFarDist);
-    if (dist < bestSoFarDist) {
-      bestSoFarDist = dist;
-      bestSoFarGroup = groups[i];
+  int count = maxGroups > 0 ? maxGroups : groups.size();
+  visited = 0;
+  // The search stops at the first centroid within epsilon, so the centroids
+  // are only compared a batch at a time without one
+  unsigned int batchSize = epsilon > 0 ? 1 : WARPED_DISTANCE_LANES;
+  vector<const TimeSeries*> batch;
+  vector<const Group*> batchGroups;
+  while (!queue.empty() && queue.top().bound < bestSoFarDist && visited < count)
+  {
+    if (bestSoFarDist < INF && (bestSoFarDist <= epsilon || deadline.expired())) {
+      break;
+    }
+    if (!queue.top().isGroup)
+    {
+      search_entry_t entry = queue.top();
+      queue.pop();
+      const super_group_t& superGroup = this->superGroups[entry.index];
+      for (uint32_t k = superGroup.childBegin; k < superGroup.childEnd; k++)
+      {
+        int child = this->superGroupChildren[k];
+        data_t bound = superGroup.leaf ? endpointLowerBound(groups[child]->getCentroid(), query)
+          : envelopeLowerBound(query, this->superGroupLower[child], this->superGroupUpper[child]);
+        bound = std::max(bound, entry.bound);
+        if (bound < bestSoFarDist) {
+          queue.push(search_entry_t(bound, child, 0, superGroup.leaf));
+        }
+      }
+      continue;
+    }
+
+    batch.clear();
+    batchGroups.clear();
+    while (!queue.empty() && queue.top().isGroup && queue.top().bound < bestSoFarDist &&
+           batch.size() < batchSize && visited + (int)batch.size() < count)
+    {
+      batchGroups.push_back(groups[queue.top().index]);
+      batch.push_back(&batchGroups.back()->getCentroid());
+      queue.pop();
+    }
+    vector<data_t> distances = warpedDistance(query, batch, bestSoFarDist);
+    visited += batch.size();
+    for (unsigned int b = 0; b < batch.size(); b++)
+    {
+      if (distances[b] < bestSoFarDist) {
+        bestSoFarDist = distances[b];
+        bestSoFarGroup = batchGroups[b];
+      }
     }
   }
 
   return std::make_pair(bestSoFarGroup, bestSoFarDist);
 }
 
-} // namespace onex
\ No newline at end of file
+data_t LocalLengthGroupSpace::getLowerBound(const TimeSeries& query)
+{
+  if (this->groups.empty()) {
+    return INF;
+  }
+  if (this->centroidLower.getLength() == 0)
+  {
+    TimeSeries lower(this->length), upper(this->length);
+    for (int k = 0; k < this->length; k++)
+    {
+      lower[k] = INF;
+      upper[k] = -INF;
+    }
+    for (unsigned int i = 0; i < this->groups.size(); i++)
+    {
+      const TimeSeries& centroid = this->groups[i]->getCentroid();
+      for (int k = 0; k < this->length; k++)
+      {
+        lower[k] = std::min(lower[k], centroid[k]);
+        upper[k] = std::max(upper[k], centroid[k]);
+      }
+    }
+    this->centroidLower = std::move(lower);
+    this->centroidUpper = std::move(upper);
+  }
+  return envelopeLowerBound(query, this->centroidLower, this->centroidUpper);
+}
+
+void LocalLengthGroupSpace::computeMemberDistances(const dist_t pairwiseDistance)
+{
+  if (!this->memberDistances.empty() || this->members.empty()) {
+    return;
+  }
+  this->dropSuperGroups();
+  this->memberDistances.resize(this->members.size());
+  vector<std::pair<data_t, uint32_t> > sorted;
+  for (unsigned int i = 0; i < this->groups.size(); i++)
+  {
+    const TimeSeries& centroid = this->groups[i]->getCentroid();
+    sorted.clear();
+    for (uint32_t k = this->memberOffsets[i]; k < this->memberOffsets[i + 1]; k++)
+    {
+      int start = this->members[k] % this->subTimeSeriesCount;
+      TimeSeries member = this->dataset.getTimeSeries(this->members[k] / this->subTimeSeriesCount,
+                                                      start, start + this->length);
+      sorted.push_back(std::make_pair(pairwiseDistance(centroid, member, INF), this->members[k]));
+    }
+    std::sort(sorted.begin(), sorted.end());
+    for (unsigned int k = 0; k < sorted.size(); k++)
+    {
+      this->memberDistances[this->memberOffsets[i] + k] = sorted[k].first;
+      this->members[this->memberOffsets[i] + k] = sorted[k].second;
+    }
+    this->groups[i]->setMemberDistances(this->memberDistances.data() + this->memberOffsets[i]);
+    this->groups[i]->setRadius(sorted.empty() ? 0 : sorted.back().first);
+  }
+}
+
+void LocalLengthGroupSpace::buildSuperGroups(const dist_t pairwiseDistance)
+{
+  if (!this->superGroups.empty() || this->groups.empty()) {
+    return;
+  }
+  vector<int> items(this->groups.size());
+  for (unsigned int i = 0; i < items.size(); i++) {
+    items[i] = i;
+  }
+  this->buildSuperGroup(pairwiseDistance, items);
+}
+
+int LocalLengthGroupSpace::buildSuperGroup(const dist_t pairwiseDistance, const vector<int>& items)
+{
+  int node = this->superGroups.size();
+  this->superGroups.push_back(super_group_t());
+
+  // Distance of every group to the closest child centre picked so far,
+  // starting with the centre of this super-group
+  const TimeSeries& centroid = this->groups[items[0]]->getCentroid();
+  vector<data_t> nearest(items.size(), 0);
+  vector<int> owner(items.size(), 0);
+  data_t radius = this->groups[items[0]]->getRadius();
+  for (unsigned int k = 1; k < items.size(); k++)
+  {
+    nearest[k] = pairwiseDistance(centroid, this->groups[items[k]]->getCentroid(), INF);
+    radius = std::max(radius, nearest[k] + this->groups[items[k]]->getRadius());
+  }
+
+  // The centroid may belong to the dataset, so the envelope is a copy
+  TimeSeries lower(this->length), upper(this->length);
+  for (int i = 0; i < this->length; i++)
+  {
+    lower[i] = centroid[i];
+    upper[i] = centroid[i];
+  }
+  for (unsigned int k = 1; k < items.size(); k++)
+  {
+    const TimeSeries& other = this->groups[items[k]]->getCentroid();
+    for (int i = 0; i < this->length; i++)
+    {
+      lower[i] = std::min(lower[i], other[i]);
+      upper[i] = std::max(upper[i], other[i]);
+    }
+  }
+  this->superGroupLower.push_back(std::move(lower));
+  this->superGroupUpper.push_back(std::move(upper));
+
+  vector<int> centres(1, 0);
+  if (items.size() > SUPER_GROUP_FANOUT)
+  {
+    while (centres.size() < SUPER_GROUP_FANOUT)
+    {
+      int farthest = std::max_element(nearest.begin(), nearest.end()) - nearest.begin();
+      if (nearest[farthest] == 0) {
+        break;
+      }
+      const TimeSeries& centre = this->groups[items[farthest]]->getCentroid();
+      for (unsigned int k = 0; k < items.size(); k++)
+      {
+        data_t dist = pairwiseDistance(centre, this->groups[items[k]]->getCentroid(), nearest[k]);
+        if (dist < nearest[k])
+        {
+          nearest[k] = dist;
+          owner[k] = centres.size();
+        }
+      }
+      nearest[farthest] = 0;
+      owner[farthest] = centres.size();
+      centres.push_back(farthest);
+    }
+  }
+
+  // Small super-groups, and the ones whose centroids are all equal, are leaves
+  vector<int> children;
+  bool leaf = centres.size() == 1;
+  if (leaf) {
+    children = items;
+  }
+  else
+  {
+    vector<vector<int> > partition(centres.size());
+    for (unsigned int c = 0; c < centres.size(); c++) {
+      partition[c].push_back(items[centres[c]]);
+    }
+    for (unsigned int k = 0; k < items.size(); k++)
+    {
+      if (items[k] != partition[owner[k]][0]) {
+        partition[owner[k]].push_back(items[k]);
+      }
+    }
+    for (unsigned int c = 0; c < partition.size(); c++) {
+      children.push_back(this->buildSuperGroup(pairwiseDistance, partition[c]));
+    }
+  }
+
+  super_group_t& superGroup = this->superGroups[node];
+  superGroup.centroid = items[0];
+  superGroup.radius = radius;
+  superGroup.leaf = leaf;
+  superGroup.childBegin = this->superGroupChildren.size();
+  this->superGroupChildren.insert(this->superGroupChildren.end(), children.begin(), children.end());
+  superGroup.childEnd = this->superGroupChildren.size();
+  return node;
+}
+
+candidate_time_series_t LocalLengthGroupSpace::getBestMatchByMetric(const TimeSeries& query,
+                                                                    const dist_t pairwiseDistance,
+                                                                    data_t dropout)
+{
+  if (query.getLength() != this->length) {
+    throw OnexException("Length of query must be the length of the groups");
+  }
+  this->computeMemberDistances(pairwiseDistance);
+  this->buildSuperGroups(pairwiseDistance);
+
+  // No member below a group or a super-group is closer than d(q, c) - radius
+  std::priority_queue<search_entry_t, vector<search_entry_t>, std::greater<search_entry_t> > queue;
+  candidate_time_series_t best(TimeSeries(0), dropout);
+  if (this->superGroups.empty()) {
+    return best;
+  }
+  const super_group_t& root = this->superGroups[0];
+  data_t rootDist = pairwiseDistance(this->groups[root.centroid]->getCentroid(), query, INF);
+  queue.push(search_entry_t(rootDist - root.radius, 0, rootDist, false));
+
+  while (!queue.empty() && queue.top().bound < best.dist)
+  {
+    search_entry_t entry = queue.top();
+    queue.pop();
+    if (entry.isGroup)
+    {
+      candidate_time_series_t candidate =
+        this->groups[entry.index]->getBestMatch(query, pairwiseDistance, entry.centroidDist, best.dist);
+      if (candidate.dist < best.dist) {
+        best = candidate;
+      }
+      continue;
+    }
+
+    const super_group_t& superGroup = this->superGroups[entry.index];
+    for (uint32_t k = superGroup.childBegin; k < superGroup.childEnd; k++)
+    {
+      int child = this->superGroupChildren[k];
+      int centroid = superGroup.leaf ? child : this->superGroups[child].centroid;
+      data_t radius = superGroup.leaf ? this->groups[child]->getRadius() : this->superGroups[child].radius;
+      // One child shares the centroid of its parent. Other distances are
+      // abandoned once the child cannot hold a better match
+      data_t dist = centroid == superGroup.centroid ? entry.centroidDist
+        : pairwiseDistance(this->groups[centroid]->getCentroid(), query, best.dist + radius);
+      if (dist - radius < best.dist) {
+        queue.push(search_entry_t(dist - radius, child, dist, superGroup.leaf));
+      }
+    }
+  }
+  return best;
+}
+
+} // namespace onex
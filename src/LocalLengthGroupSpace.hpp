@@ -8,6 +8,9 @@
 #include "TimeSeries.hpp"
 #include "distance/Distance.hpp"
 #include "Group.hpp"
+#include "GroupFile.hpp"
+#include "MappedFile.hpp"
+#include "Deadline.hpp"
 
 using std::vector;
 
@@ -15,6 +18,35 @@ namespace onex {
 
 typedef std::pair<const Group*, data_t> candidate_group_t;
 
+/**
+ *  @brief order in which generateGroups visits the sub-sequences of a length
+ */
+enum group_order_t
+{
+  GROUP_ORDER_START,  // every time series at start 0, then at start 1, ...
+  GROUP_ORDER_MEAN,   // by the mean of the sub-sequence
+  GROUP_ORDER_PAA     // by a Z-order curve over a quantized 4-segment PAA
+};
+
+/**
+ *  @brief a node of the hierarchy of super-groups built over the centroids of
+ *         a length
+ *
+ *  A super-group is centred on the centroid of one of the groups below it and
+ *  its radius covers every member of these groups. The pointwise envelope of
+ *  the centroids below it is kept next to it. The children of a leaf are
+ *  groups, the children of other super-groups are super-groups.
+ */
+struct super_group_t
+{
+  int centroid;                   // index of the group whose centroid is used
+  data_t radius;
+  uint32_t childBegin, childEnd;  // range of the children in superGroupChildren
+  bool leaf;
+
+  super_group_t() : centroid(-1), radius(0), childBegin(0), childEnd(0), leaf(true) {}
+};
+
 class LocalLengthGroupSpace
 {
 public:
@@ -42,6 +74,37 @@ public:
    */
   int getNumberOfGroups(void) const;
 
+  /**
+   *  @brief gets the approximate number of bytes used by the groups of this length
+   */
+  size_t getMemoryUsage(void) const;
+
+  /**
+   *  @brief gets the number of bytes of the Keogh envelopes cached for the
+   *         centroids of this length. They are included in getMemoryUsage
+   */
+  size_t getKeoghCacheMemoryUsage(void) const;
+
+  /**
+   *  @brief predicts the value of getMemoryUsage after grouping
+   *
+   *  Centroids are assumed to be references to the dataset and envelopes
+   *  are not counted.
+   *
+   *  @param itemCount number of time series in the dataset
+   *  @param itemLength length of the time series in the dataset
+   *  @param length length of the groups
+   *  @param groupCount number of groups
+   *  @return the predicted number of bytes
+   */
+  static size_t estimateMemoryUsage(int itemCount, int itemLength, int length, int groupCount);
+
+  /**
+   *  @brief gets the number of bytes used while the groups of a length are
+   *         built, on top of the groups themselves
+   */
+  static size_t estimateBuildMemoryUsage(int itemCount, int itemLength, int length);
+
    /**
    *  @return a group with given index
    */
@@ -49,15 +112,98 @@ public:
   
   void saveGroups(std::ofstream &fout, bool groupSizeOnly) const;
   int loadGroups(std::ifstream &fin);
+
+  /**
+   *  @brief writes the groups as a section of a binary group file
+   *
+   *  @param fout the file. The section starts at its current position
+   */
+  void saveGroupsBinary(std::ofstream &fout) const;
+
+  /**
+   *  @brief loads the groups from a section of a binary group file
+   *
+   *  @param file the mapped group file
+   *  @param offset offset of the section in the file
+   *  @param fileHeader header of the file
+   *  @return number of loaded groups
+   *
+   *  @throw OnexException if the section is corrupted
+   */
+  int loadGroupsBinary(const MappedFile& file, uint64_t offset,
+                       const group_file_header_t& fileHeader);
   
   /**
    *  @brief generates all the groups for the timeseries of this length
    *
+   *  Every sub-sequence joins the closest centroid within threshold / 2, or
+   *  becomes the centroid of a new group. When the sub-sequences are sorted
+   *  by a signature, similar ones arrive together, so centroids are compared
+   *  from the newest to the oldest. The closest one is usually found first
+   *  and the distances to the others are abandoned early.
+   *
+   *  By default, the first member of a group stays its centroid. With mean
+   *  centroids, the centroid is the running mean of the members that have
+   *  joined. Since the mean moves, every member is checked against the final
+   *  centroids afterwards and the ones that drifted farther than
+   *  threshold / 2 move to the closest centroid within threshold / 2, or to
+   *  a new group. The radius of every group is recorded either way.
+   *
    *  @param pairwiseDistance the distance to use when computing the groups
    *  @param threshold the threshold to use when splitting into new groups
+   *  @param order the order in which the sub-sequences are grouped
+   *  @param meanCentroids whether centroids are the mean of their members
    *  @return number of generated groups
    */
-  int generateGroups(const dist_t pairwiseDistance, data_t threshold);
+  int generateGroups(const dist_t pairwiseDistance, data_t threshold,
+                     group_order_t order = GROUP_ORDER_START, bool meanCentroids = false);
+
+  /**
+   *  @brief generates all the groups for the timeseries of this length in
+   *         two phases, so that most of the work is done in parallel
+   *
+   *  A random sample is grouped first as in generateGroups to find the
+   *  centroids. Then every sub-sequence joins its closest centroid within
+   *  threshold / 2, in parallel. The sub-sequences that are too far from
+   *  every centroid are grouped among themselves at the end, in dataset
+   *  order. As with generateGroups, every member is within threshold / 2 of
+   *  its centroid, but the groups are not the same.
+   *
+   *  @param pairwiseDistance the distance to use when computing the groups
+   *  @param threshold the threshold to use when splitting into new groups
+   *  @param numThreads number of threads. See getNumberOfThreads
+   *  @return number of generated groups
+   */
+  int generateGroups(const dist_t pairwiseDistance, data_t threshold, int numThreads);
+
+  /**
+   *  @brief refines the groups with a few k-means-style iterations
+   *
+   *  Each iteration moves every grouped sub-sequence to its closest centroid,
+   *  dissolves the groups with fewer than minGroupSize members whose members
+   *  all have another centroid within threshold / 2, and sets each centroid
+   *  to the mean of its members. A mean is only kept if every member is
+   *  within threshold / 2 of it, so the groups stay valid. Empty groups are
+   *  removed and the iterations stop early once no member moves.
+   *
+   *  @param pairwiseDistance the distance used to make the groups
+   *  @param threshold the threshold used to make the groups
+   *  @param iterations maximum number of iterations
+   *  @param minGroupSize groups with fewer members are merged into others
+   *  @param numThreads number of threads. See getNumberOfThreads
+   *  @param hasMeanCentroids set to whether any centroid is a mean, which
+   *         owns its values, after refinement
+   *  @return number of groups after refinement
+   */
+  int refineGroups(const dist_t pairwiseDistance, data_t threshold,
+                   int iterations, int minGroupSize, int numThreads, bool& hasMeanCentroids);
+
+  /**
+   *  @brief removes the groups with a single member
+   *
+   *  @return number of removed groups
+   */
+  int dropSingletonGroups();
 
   /**
    *  @brief gets the group closest to a query (measured from the centroid)
@@ -70,11 +216,185 @@ public:
                                  const dist_t warpedDistance,
                                  data_t dropout) const;
 
+  /**
+   *  @brief gets a group close to a query, stopping early
+   *
+   *  The groups are visited by increasing endpointLowerBound, so the closest
+   *  ones usually come first, and the scan ends once the bound is not less
+   *  than the best distance so far. Once the super-groups are built, they
+   *  are descended best-first instead, and a super-group is skipped when the
+   *  envelopeLowerBound of its centroids is not less than the best distance
+   *  so far. The search also stops at the first centroid within epsilon of
+   *  the query, after maxGroups centroids, or when the deadline expires with
+   *  a group found.
+   *
+   *  @param query the time series we're operating with
+   *  @param warpedDistance the distance between the query and a batch of
+   *         centroids, e.g. cascadeDistanceBatch
+   *  @param dropout only groups closer than this are returned
+   *  @param epsilon a centroid within this distance is good enough. The
+   *         members of its group may be farther
+   *  @param maxGroups maximum number of centroids compared. 0 means no limit
+   *  @param deadline the time limit of the search
+   *  @param visited set to the number of centroids compared
+   */
+  candidate_group_t getBestGroup(const TimeSeries& query,
+                                 const batch_dist_t& warpedDistance,
+                                 data_t dropout, data_t epsilon, int maxGroups,
+                                 const Deadline& deadline, int& visited) const;
+
+  /**
+   *  @brief gets a lower bound of the warped distance between a query and
+   *         every centroid of this length
+   *
+   *  The query is compared with the pointwise envelope of all centroids, see
+   *  envelopeLowerBound. The envelope is computed the first time.
+   *
+   *  @param query the query, of any length
+   *  @return the bound, or INF if there is no group
+   */
+  data_t getLowerBound(const TimeSeries& query);
+
+  /**
+   *  @brief gets the number of super-groups built over the centroids, see
+   *         buildSuperGroups
+   *
+   *  @return the number of super-groups, or 0 if they are not built yet
+   */
+  int getNumberOfSuperGroups(void) const { return this->superGroups.size(); }
+
+  /**
+   *  @brief builds the super-groups if they are not built yet
+   *
+   *  They are used by getBestGroup and getBestMatchByMetric. Their radii are
+   *  only exact if the radii of the groups are, which getBestMatchByMetric
+   *  makes sure of.
+   *
+   *  @param pairwiseDistance the distance the groups were made with
+   */
+  void buildSuperGroups(const dist_t pairwiseDistance);
+
+  /**
+   *  @brief gets the best match of a query of this length by a metric
+   *
+   *  The groups are clustered into a hierarchy of super-groups, which is
+   *  descended best-first. A super-group or a group is visited by increasing
+   *  d(q, c) - radius, which bounds the distance of everything below it, and
+   *  the search stops once the bound is not less than the best distance so
+   *  far. So only the centroids near the query are compared with it instead
+   *  of all of them. Within a group, members are pruned by the triangle
+   *  inequality, see Group::getBestMatch.
+   *
+   *  The first time, the distances between the members and their centroid
+   *  are computed, the members of every group are sorted by them and the
+   *  super-groups are built.
+   *
+   *  @param query the query, whose length must be the length of this space
+   *  @param pairwiseDistance the metric the groups were made with
+   *  @param dropout only matches closer than this are returned
+   *  @return the best match, or an empty time series at distance dropout if
+   *          no sub-sequence is closer than dropout
+   */
+  candidate_time_series_t getBestMatchByMetric(const TimeSeries& query,
+                                               const dist_t pairwiseDistance,
+                                               data_t dropout);
+
 private:
+  /**
+   *  @brief gets the number of sub-sequences of this length
+   *
+   *  @throw OnexException if member coordinates do not fit in 32 bits
+   */
+  uint32_t getSubsequenceCount() const;
+
+  /**
+   *  @brief gets the coordinates of all sub-sequences, packed as
+   *         index * subTimeSeriesCount + start, in the given order
+   */
+  vector<uint32_t> getGroupingOrder(group_order_t order) const;
+
+  /**
+   *  @brief groups the sub-sequences in the given order with mean centroids,
+   *         see generateGroups
+   */
+  void generateMeanGroups(const dist_t pairwiseDistance, data_t threshold,
+                          const vector<uint32_t>& coords, bool newestFirst);
+
+  /**
+   *  @brief computes memberDistances if they are not known, sorts the
+   *         members of each group by them and sets the radius of every group
+   *
+   *  Super-groups built before are dropped, since their radii may be off.
+   */
+  void computeMemberDistances(const dist_t pairwiseDistance);
+
+  /**
+   *  @brief drops the super-groups
+   */
+  void dropSuperGroups();
+
+  /**
+   *  @brief builds the super-group of the given groups and the ones below it
+   *
+   *  Up to SUPER_GROUP_FANOUT children are centred on centroids picked
+   *  farthest-first, and every group goes to the child with the closest
+   *  centroid.
+   *
+   *  @param items indices of the groups. The first one is the centre
+   *  @return index of the super-group
+   */
+  int buildSuperGroup(const dist_t pairwiseDistance, const vector<int>& items);
+
+  /**
+   *  @brief allocates an empty member map for building the groups
+   *
+   *  @throw OnexException if member coordinates do not fit in 32 bits
+   */
+  void allocateMemberMap();
+
+  /**
+   *  @brief packs the members of all groups into memberOffsets and members and
+   *         frees the member map
+   *
+   *  Members of each group are stored in dataset order.
+   */
+  void freeze();
+
+  /**
+   *  @brief fills memberOffsets and members from the group of every
+   *         sub-sequence and sets the members of the groups
+   *
+   *  @param subsequenceCount number of sub-sequences
+   *  @param groupOf gets the group of a sub-sequence, or -1 if it has none
+   */
+  void packMembers(uint32_t subsequenceCount, const std::function<int(uint32_t)>& groupOf);
+
   int length, subTimeSeriesCount;
   const TimeSeriesSet& dataset;
   vector<Group*> groups;
+
+  // Only used while the groups are being built
   vector<group_membership_t> memberMap;
+
+  // Members of group i are at [memberOffsets[i], memberOffsets[i + 1]) of members
+  vector<uint32_t> memberOffsets;
+  vector<uint32_t> members;
+
+  // Distance between each member and its centroid, in the order of members.
+  // Empty until a query by metric needs them. Members of each group are then
+  // sorted by this distance instead of by position in the dataset
+  vector<data_t> memberDistances;
+
+  // Hierarchy over the groups. The root is the first super-group. The
+  // envelope of the centroids below super-group i is superGroupLower[i] and
+  // superGroupUpper[i]
+  vector<super_group_t> superGroups;
+  vector<int> superGroupChildren;
+  vector<TimeSeries> superGroupLower, superGroupUpper;
+
+  // Pointwise minimum and maximum of all centroids. Empty until a query needs
+  // them
+  TimeSeries centroidLower, centroidUpper;
 };
 
 } // namespace onex
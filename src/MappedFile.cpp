@@ -0,0 +1,84 @@
+#include "MappedFile.hpp"
+#include "Exception.hpp"
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using std::string;
+
+namespace onex {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const string& filePath) : data(nullptr), size(0)
+{
+  std::ifstream f(filePath, std::ios::binary);
+  if (!f.is_open())
+  {
+    throw OnexException(string("Cannot open ") + filePath);
+  }
+  f.seekg(0, std::ios::end);
+  this->size = (size_t)f.tellg();
+  this->data = new char[this->size > 0 ? this->size : 1];
+  f.seekg(0);
+  if (!f.read(this->data, this->size))
+  {
+    delete[] this->data;
+    throw OnexException(string("Error while reading ") + filePath);
+  }
+}
+
+MappedFile::~MappedFile()
+{
+  delete[] this->data;
+}
+
+#else
+
+MappedFile::MappedFile(const string& filePath) : data(nullptr), size(0)
+{
+  int fd = open(filePath.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    throw OnexException(string("Cannot open ") + filePath);
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    close(fd);
+    throw OnexException(string("Cannot read the size of ") + filePath);
+  }
+  this->size = (size_t)st.st_size;
+
+  // An empty file cannot be mapped, but there is nothing to read from it anyway
+  if (this->size > 0)
+  {
+    void* addr = mmap(nullptr, this->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+      close(fd);
+      throw OnexException(string("Cannot map ") + filePath + " into memory");
+    }
+    this->data = (char*)addr;
+  }
+  // The mapping stays valid after the descriptor is closed
+  close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (this->data) {
+    munmap(this->data, this->size);
+  }
+}
+
+#endif
+
+} // namespace onex
@@ -0,0 +1,55 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace onex {
+
+/**
+ *  @brief a file mapped into memory
+ *
+ *  Pages of the file are read on demand by the operating system, so opening a
+ *  file takes the same time regardless of its size. The mapping is private:
+ *  writes to it are visible only to this process and never reach the file.
+ *  On platforms without mmap, the whole file is read into memory instead.
+ */
+class MappedFile
+{
+public:
+
+  /**
+   *  @brief maps a file into memory
+   *
+   *  @param filePath path to the file
+   *
+   *  @throw OnexException if the file cannot be opened or mapped
+   */
+  MappedFile(const std::string& filePath);
+
+  /**
+   *  @brief destructor. Unmaps the file
+   */
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /**
+   *  @brief gets the beginning of the mapped file
+   */
+  char* getData() const { return this->data; }
+
+  /**
+   *  @brief gets the size of the mapped file in bytes
+   */
+  size_t getSize() const { return this->size; }
+
+private:
+  char* data;
+  size_t size;
+};
+
+} // namespace onex
+
+#endif // MAPPED_FILE_H
@@ -15,12 +15,13 @@ OnexAPI::~OnexAPI()
 }
 
 dataset_info_t OnexAPI::loadDataset(const string& filePath, int maxNumRow,
-                                     int startCol, const string& separators)
+                                     int startCol, const string& separators,
+                                     int numThreads)
 {
 
   GroupableTimeSeriesSet* newSet = new GroupableTimeSeriesSet();
   try {
-    newSet->loadData(filePath, maxNumRow, startCol, separators);
+    newSet->loadData(filePath, maxNumRow, startCol, separators, numThreads);
   } catch (OnexException& e)
   {
     delete newSet;
@@ -54,6 +55,12 @@ void OnexAPI::saveDataset(int index, const string& filePath, char separator)
   this->loadedDatasets[index]->saveData(filePath, separator);
 }
 
+void OnexAPI::saveDatasetBinary(int index, const string& filePath)
+{
+  this->_checkDatasetIndex(index);
+  this->loadedDatasets[index]->saveBinaryData(filePath);
+}
+
 void OnexAPI::unloadDataset(int index)
 {
   this->_checkDatasetIndex(index);
@@ -114,16 +121,32 @@ std::pair<data_t, data_t> OnexAPI::normalizeDataset(int idx)
   return this->loadedDatasets[idx]->normalize();
 }
 
-int OnexAPI::groupDataset(int index, data_t threshold)
+int OnexAPI::groupDataset(int index, data_t threshold, int numThreads, group_order_t order,
+                          bool meanCentroids)
 {
   this->_checkDatasetIndex(index);
-  return this->loadedDatasets[index]->groupAllLengths("euclidean", threshold);
+  return this->loadedDatasets[index]->groupAllLengths("euclidean", threshold, numThreads, order,
+                                                      meanCentroids);
 }
 
-void OnexAPI::saveGroup(int index, const string &path, bool groupSizeOnly)
+refine_result_t OnexAPI::refineGroups(int index, int iterations, int minGroupSize, int numThreads)
 {
   this->_checkDatasetIndex(index);
-  this->loadedDatasets[index]->saveGroups(path, groupSizeOnly);
+  return this->loadedDatasets[index]->refineGroups(iterations, minGroupSize, numThreads);
+}
+
+auto_group_result_t OnexAPI::groupDatasetWithBudget(int index, int maxGroupCount, size_t maxMemoryUsage,
+                                                    bool dropSingletons)
+{
+  this->_checkDatasetIndex(index);
+  return this->loadedDatasets[index]->groupAllLengthsWithBudget("euclidean", maxGroupCount, maxMemoryUsage,
+                                                                dropSingletons);
+}
+
+void OnexAPI::saveGroup(int index, const string &path, bool groupSizeOnly, int version)
+{
+  this->_checkDatasetIndex(index);
+  this->loadedDatasets[index]->saveGroups(path, groupSizeOnly, version);
 }
 
 int OnexAPI::loadGroup(int index, const string& path)
@@ -132,11 +155,53 @@ int OnexAPI::loadGroup(int index, const string& path)
   return this->loadedDatasets[index]->loadGroups(path);
 }
 
+void OnexAPI::setGroupMemoryLimit(int index, size_t bytes)
+{
+  this->_checkDatasetIndex(index);
+  this->loadedDatasets[index]->setGroupMemoryLimit(bytes);
+}
+
+memory_usage_t OnexAPI::getMemoryUsage(int index)
+{
+  this->_checkDatasetIndex(index);
+  return this->loadedDatasets[index]->getMemoryUsage();
+}
+
+size_t OnexAPI::getTotalMemoryUsage()
+{
+  size_t bytes = 0;
+  for (unsigned int i = 0; i < this->loadedDatasets.size(); i++)
+  {
+    if (this->loadedDatasets[i] != nullptr)
+    {
+      memory_usage_t usage = this->loadedDatasets[i]->getMemoryUsage();
+      bytes += usage.dataset + usage.groups;
+    }
+  }
+  return bytes;
+}
+
+group_estimate_t OnexAPI::estimateGroupDataset(int index, data_t threshold, int sampleLengths)
+{
+  this->_checkDatasetIndex(index);
+  return this->loadedDatasets[index]->estimateGroups("euclidean", threshold, sampleLengths);
+}
+
 void OnexAPI::setWarpingBandRatio(double ratio)
 {
   onex::setWarpingBandRatio(ratio);
 }
 
+cascade_stats_t OnexAPI::getCascadeStats()
+{
+  return onex::getCascadeStats();
+}
+
+void OnexAPI::resetCascadeStats()
+{
+  onex::resetCascadeStats();
+}
+
 candidate_time_series_t OnexAPI::getBestMatch(int result_idx, int query_idx, int index, int start, int end)
 {
   this->_checkDatasetIndex(result_idx);
@@ -146,6 +211,44 @@ candidate_time_series_t OnexAPI::getBestMatch(int result_idx, int query_idx, int
   return loadedDatasets[result_idx]->getBestMatch(query);
 }
 
+match_result_t OnexAPI::getApproximateMatch(int result_idx, int query_idx, const match_options_t& options,
+                                            int index, int start, int end)
+{
+  this->_checkDatasetIndex(result_idx);
+  this->_checkDatasetIndex(query_idx);
+
+  const TimeSeries& query = loadedDatasets[query_idx]->getTimeSeries(index, start, end);
+  return loadedDatasets[result_idx]->getBestMatch(query, options);
+}
+
+candidate_time_series_t OnexAPI::getBestMatchEuclidean(int result_idx, int query_idx, int index, int start, int end)
+{
+  this->_checkDatasetIndex(result_idx);
+  this->_checkDatasetIndex(query_idx);
+
+  const TimeSeries& query = loadedDatasets[query_idx]->getTimeSeries(index, start, end);
+  return loadedDatasets[result_idx]->getBestMatchEuclidean(query);
+}
+
+candidate_time_series_t OnexAPI::getBestMatchBruteForce(int result_idx, int query_idx, int index, int start, int end)
+{
+  this->_checkDatasetIndex(result_idx);
+  this->_checkDatasetIndex(query_idx);
+
+  const TimeSeries& query = loadedDatasets[query_idx]->getTimeSeries(index, start, end);
+  return loadedDatasets[result_idx]->getBestMatchBruteForce(query);
+}
+
+vector<candidate_time_series_t> OnexAPI::getMatchesWithin(int result_idx, int query_idx, data_t radius,
+                                                          int index, int start, int end)
+{
+  this->_checkDatasetIndex(result_idx);
+  this->_checkDatasetIndex(query_idx);
+
+  const TimeSeries& query = loadedDatasets[query_idx]->getTimeSeries(index, start, end);
+  return loadedDatasets[result_idx]->getMatchesWithin(query, radius);
+}
+
 dataset_info_t OnexAPI::PAA(int idx, int n)
 {
   this->_checkDatasetIndex(idx);
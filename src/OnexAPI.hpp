@@ -51,20 +51,39 @@ public:
    *  maxNumRow is larger than or equal to the actual number of lines, or maxNumRow is
    *  not positive all lines are read.
    *
+   *  Binary datasets written by saveDatasetBinary and NumPy .npy files are
+   *  recognized by their content and mapped into memory instead.
+   *
    *  @param filePath path to a text file
    *  @param maxNumRow maximum number of rows to be read. If this value is not positive,
    *         all lines are read
    *  @param separator a string containings possible separator characters for values
    *         in a line
    *  @param startCol columns before startCol are discarded
+   *  @param numThreads number of threads used for parsing the file. If this value
+   *         is not positive, all hardware threads are used
    *  @return an index used to refer to the just loaded dataset
    *
    *  @throw OnexException if cannot read from the given file
    */
   dataset_info_t loadDataset(const string& filePath, int maxNumRow,
-                             int startCol, const string& separators);
+                             int startCol, const string& separators,
+                             int numThreads = 1);
 
-  void saveDataset(int index, const string& filePath, char separator);                           
+  void saveDataset(int index, const string& filePath, char separator);
+
+  /**
+   *  @brief saves a dataset to a binary file
+   *
+   *  Binary files are loaded by loadDataset in constant time because the
+   *  values are mapped into memory instead of parsed.
+   *
+   *  @param index index of the dataset
+   *  @param filePath path to the binary file
+   *
+   *  @throw OnexException if cannot write to the given file
+   */
+  void saveDatasetBinary(int index, const string& filePath);
 
   /**
    *  @brief unloads a dataset at given index
@@ -116,15 +135,107 @@ public:
    *  @param the index of the dataset to be grouped
    *  @param threshold the threshold to use when creating the group
    *  @param distance_name the distance to use when grouping the data
+   *  @param numThreads number of threads. With one thread, the dataset is
+   *         grouped sequentially, otherwise in two phases. If this value is
+   *         not positive, all hardware threads are used
+   *  @param order the order in which sub-sequences are grouped sequentially.
+   *         Sorting them by a signature such as GROUP_ORDER_PAA usually gives
+   *         fewer groups in less time
+   *  @param meanCentroids whether centroids are the mean of their members
+   *         instead of their first member. Mean centroids give fewer groups
+   *         with smaller radii
    *  @return the number of groups created
    */
-  int groupDataset(int idx, data_t threshold);
+  int groupDataset(int idx, data_t threshold, int numThreads = 1,
+                   group_order_t order = GROUP_ORDER_START, bool meanCentroids = false);
 
-  void saveGroup(int idx, const string& path, bool groupSizeOnly);
+  /**
+   *  @brief groups the dataset with a threshold chosen to fit a budget
+   *
+   *  See GroupableTimeSeriesSet::groupAllLengthsWithBudget.
+   *
+   *  @param idx the index of the dataset to be grouped
+   *  @param maxGroupCount maximum number of groups. 0 means no limit
+   *  @param maxMemoryUsage maximum bytes used by the groups. 0 means no limit
+   *  @param dropSingletons whether to remove singleton groups when over budget
+   *  @return the chosen threshold with the predicted and actual size
+   */
+  auto_group_result_t groupDatasetWithBudget(int idx, int maxGroupCount, size_t maxMemoryUsage,
+                                             bool dropSingletons = false);
+
+  /**
+   *  @brief refines the groups of a dataset with a few k-means-style iterations
+   *
+   *  See GroupableTimeSeriesSet::refineGroups.
+   *
+   *  @param idx the index of the grouped dataset
+   *  @param iterations maximum number of iterations per length
+   *  @param minGroupSize groups with fewer members are merged into others
+   *  @param numThreads number of threads. If this value is not positive, all
+   *         hardware threads are used
+   *  @return the number of groups and their memory usage before and after
+   */
+  refine_result_t refineGroups(int idx, int iterations = 5, int minGroupSize = 2, int numThreads = 1);
+
+  /**
+   *  @brief saves the groups of a dataset
+   *
+   *  @param idx the index of the dataset
+   *  @param path path to the group file
+   *  @param groupSizeOnly if true, only the sizes of the groups are saved
+   *  @param version version of the group file format. Version 1 is text and
+   *         version 2 is binary
+   */
+  void saveGroup(int idx, const string& path, bool groupSizeOnly,
+                 int version = GROUP_FILE_VERSION);
   int loadGroup(int idx, const string& path);
 
+  /**
+   *  @brief limits the memory used by groups of a dataset that were loaded
+   *         from a binary group file
+   *
+   *  @param idx the index of the dataset
+   *  @param bytes the limit in bytes. 0 means no limit
+   */
+  void setGroupMemoryLimit(int idx, size_t bytes);
+
+  /**
+   *  @brief gets the memory used by a dataset and its groups
+   *
+   *  @param idx the index of the dataset
+   *  @return the usage in bytes, with the groups broken down by length
+   */
+  memory_usage_t getMemoryUsage(int idx);
+
+  /**
+   *  @brief gets the number of bytes allocated for all loaded datasets and
+   *         their groups. Mapped files are not counted
+   */
+  size_t getTotalMemoryUsage();
+
+  /**
+   *  @brief predicts the number of groups and their memory usage if a dataset
+   *         were grouped with the given threshold
+   *
+   *  Only a sample of the lengths is grouped, so this is much faster than
+   *  groupDataset. The dataset itself is not changed.
+   *
+   *  @param idx the index of the dataset
+   *  @param threshold the threshold that would be used for grouping
+   *  @param sampleLengths number of lengths that are actually grouped
+   *  @return the prediction
+   */
+  group_estimate_t estimateGroupDataset(int idx, data_t threshold, int sampleLengths = 8);
+
   void setWarpingBandRatio(double ratio);
 
+  /**
+   *  @brief gets how many pairs each stage of the DTW cascade pruned since
+   *         the start or the last resetCascadeStats, see cascadeDistance
+   */
+  cascade_stats_t getCascadeStats();
+  void resetCascadeStats();
+
   /**
    *  @brief gets the best match in a dataset
    *
@@ -138,6 +249,74 @@ public:
   candidate_time_series_t getBestMatch(
       int result_idx, int query_idx, int index, int start = -1, int end = -1);
 
+  /**
+   *  @brief gets a match in a dataset that is good enough, stopping early
+   *
+   *  See GlobalGroupSpace::getBestMatch. With options.timeBudget, this is
+   *  getBestMatch with a bounded latency: the best match found in time is
+   *  returned and the result is flagged as not complete.
+   *
+   *  @param result_idx the index of the result dataset
+   *  @param query_idx the index of the query dataset
+   *  @param options the tolerance and the budgets of the search
+   *  @param index the index of the timeseries in the query dataset
+   *  @param start the start of the index
+   *  @param end the end of the index
+   *  @return the match and how much of the search was done
+   */
+  match_result_t getApproximateMatch(
+      int result_idx, int query_idx, const match_options_t& options,
+      int index, int start = -1, int end = -1);
+
+  /**
+   *  @brief gets the best match in a dataset by Euclidean distance using its groups
+   *
+   *  Only sub-sequences of the same length as the query are considered. The
+   *  groups are pruned by the triangle inequality, so most members are never
+   *  compared with the query, and the result is exact.
+   *
+   *  @param result_idx the index of the result dataset
+   *  @param query_idx the index of the query dataset
+   *  @param index the index of the timeseries in the query dataset
+   *  @param start the start of the index
+   *  @param end the end of the index
+   *  @return best match in the dataset
+   */
+  candidate_time_series_t getBestMatchEuclidean(
+      int result_idx, int query_idx, int index, int start = -1, int end = -1);
+
+  /**
+   *  @brief gets the best match in a dataset by brute force
+   *
+   *  Unlike getBestMatch, this does not need the dataset to be grouped. Only
+   *  sub-sequences of the same length as the query are considered and they
+   *  are compared by Euclidean distance. The distance profiles are computed
+   *  with MASS, which is faster than the grouped index for long queries.
+   *
+   *  @param result_idx the index of the result dataset
+   *  @param query_idx the index of the query dataset
+   *  @param index the index of the timeseries in the query dataset
+   *  @param start the start of the index
+   *  @param end the end of the index
+   *  @return best match in the dataset
+   */
+  candidate_time_series_t getBestMatchBruteForce(
+      int result_idx, int query_idx, int index, int start = -1, int end = -1);
+
+  /**
+   *  @brief gets all sub-sequences within a Euclidean distance from a query
+   *
+   *  @param result_idx the index of the result dataset
+   *  @param query_idx the index of the query dataset
+   *  @param radius maximum distance of a returned sub-sequence
+   *  @param index the index of the timeseries in the query dataset
+   *  @param start the start of the index
+   *  @param end the end of the index
+   *  @return the matches sorted by distance
+   */
+  vector<candidate_time_series_t> getMatchesWithin(
+      int result_idx, int query_idx, data_t radius, int index, int start = -1, int end = -1);
+
   dataset_info_t PAA(int idx, int n);
 
 private:
@@ -0,0 +1,82 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace onex {
+
+/**
+ *  @brief resolves a requested number of threads
+ *
+ *  @param numThreads requested number of threads. If this is not positive,
+ *         the number of hardware threads is used
+ *  @return a positive number of threads
+ */
+inline int getNumberOfThreads(int numThreads)
+{
+  if (numThreads > 0) {
+    return numThreads;
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ *  @brief runs task(i) for every i in [0, count) using up to numThreads threads
+ *
+ *  Tasks are handed out dynamically, so they do not need to take the same
+ *  time. If tasks throw, the exception of the task with the smallest index is
+ *  rethrown after all threads finish. With one thread, the tasks run in order
+ *  on the calling thread.
+ *
+ *  @param count number of tasks
+ *  @param numThreads maximum number of threads. See getNumberOfThreads
+ *  @param task a callable taking the index of a task
+ */
+template <typename F>
+void parallelFor(int count, int numThreads, F task)
+{
+  numThreads = std::min(getNumberOfThreads(numThreads), count);
+  if (numThreads <= 1)
+  {
+    for (int i = 0; i < count; i++) {
+      task(i);
+    }
+    return;
+  }
+
+  std::atomic<int> next(0);
+  std::vector<std::exception_ptr> errors(count);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; t++)
+  {
+    threads.push_back(std::thread([&]() {
+      int i;
+      while ((i = next++) < count)
+      {
+        try {
+          task(i);
+        }
+        catch (...) {
+          errors[i] = std::current_exception();
+        }
+      }
+    }));
+  }
+  for (unsigned int t = 0; t < threads.size(); t++) {
+    threads[t].join();
+  }
+  for (int i = 0; i < count; i++)
+  {
+    if (errors[i]) {
+      std::rethrow_exception(errors[i]);
+    }
+  }
+}
+
+} // namespace onex
+
+#endif // PARALLEL_H
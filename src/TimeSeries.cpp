@@ -17,6 +17,7 @@ TimeSeries& TimeSeries::operator=(const TimeSeries& other)
   if (isOwnerOfData) {
     delete[] this->data;
   }
+  keoghCacheValid = false;
   isOwnerOfData = other.isOwnerOfData;
   index = other.index;
   start = other.start;
@@ -35,6 +36,10 @@ TimeSeries& TimeSeries::operator=(const TimeSeries& other)
 
 TimeSeries& TimeSeries::operator=(TimeSeries&& other)
 {
+  if (isOwnerOfData && data != other.data) {
+    delete[] this->data;
+  }
+  keoghCacheValid = false;
   data = other.data;
   index = other.index;
   start = other.start;
@@ -99,6 +104,18 @@ const data_t* TimeSeries::getKeoghUpper(int warpingBand) const
   return keoghUpper;
 }
 
+size_t TimeSeries::getMemoryUsage() const
+{
+  size_t bytes = this->isOwnerOfData ? this->length * sizeof(data_t) : 0;
+  return bytes + this->getKeoghCacheMemoryUsage();
+}
+
+size_t TimeSeries::getKeoghCacheMemoryUsage() const
+{
+  // Both envelopes are allocated together
+  return this->keoghLower ? 2 * this->length * sizeof(data_t) : 0;
+}
+
 void TimeSeries::generateKeoghLU(int warpingBand) const
 {
   delete[] keoghLower;
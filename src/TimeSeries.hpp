@@ -166,6 +166,17 @@ public:
   const data_t* getKeoghLower(int warpingBand) const;
   const data_t* getKeoghUpper(int warpingBand) const;
 
+  /**
+   *  @brief gets the number of bytes allocated by this time series for its
+   *         values and its cached Keogh envelope
+   */
+  size_t getMemoryUsage() const;
+
+  /**
+   *  @brief gets the number of bytes allocated for the cached Keogh envelope
+   */
+  size_t getKeoghCacheMemoryUsage() const;
+
   const data_t* getData() const;
   std::string getIdentifierString() const;
   void printData(std::ostream &out = std::cout) const;
@@ -203,7 +214,7 @@ struct candidate_time_series_t
 
   bool operator<(const candidate_time_series_t& rhs) const 
   {
-    if (abs(dist - rhs.dist) < EPS)
+    if (std::fabs(dist - rhs.dist) < EPS)
     {
       if (data.getIndex() == rhs.data.getIndex())
       {
@@ -5,28 +5,59 @@
 #include <fstream>
 #include <iostream>
 #include <cstring>
-#include <boost/tokenizer.hpp>
+#include <cstdlib>
+#include <cstdint>
+#include <cctype>
+#include <cerrno>
+#include <limits>
 
 #include "distance/Distance.hpp"
+#include "distance/MASS.hpp"
+#include "BinaryFile.hpp"
 #include "Exception.hpp"
+#include "MappedFile.hpp"
+#include "Parallel.hpp"
+
+// Size of a block read from a dataset file at once
+#define READ_BUFFER_SIZE (1 << 24)
+// Minimum number of bytes of a dataset file parsed by one thread
+#define MIN_CHUNK_SIZE (1 << 22)
+
+#define BINARY_DATASET_MAGIC "ONEXDATA"
+#define BINARY_DATASET_VERSION 1
+// Flags of a binary dataset
+#define BINARY_DATASET_NORMALIZED 1
+
+#define NPY_MAGIC "\x93NUMPY"
 
 using std::string;
+using std::vector;
 
 namespace onex {
 
-TimeSeriesSet::~TimeSeriesSet()
+/**
+ * Header of a binary dataset file. Values follow at offset headerSize.
+ */
+struct binary_dataset_header_t
 {
-  this->clearData();
-}
+  char magic[8];
+  uint32_t version;
+  uint32_t headerSize;
+  uint64_t itemCount;
+  uint64_t itemLength;
+  uint32_t valueSize;
+  uint32_t flags;
+  double normalizationMin;
+  double normalizationMax;
+  uint64_t reserved;
+};
+
+static_assert(sizeof(binary_dataset_header_t) == 64,
+              "Header of a binary dataset must not contain padding");
 
-int countNumberOfLines(std::ifstream& f)
+TimeSeriesSet::~TimeSeriesSet()
 {
-  int lineCount = 0;
-  string line;
-  for (lineCount = 0; std::getline(f, line); ++lineCount);
-  f.clear();
-  f.seekg(0);
-  return lineCount;
+  this->clearData();
 }
 
 inline int calcPAALength(int srcLength, int n)
@@ -71,97 +102,533 @@ TimeSeries tsPAA(const TimeSeries& source, int n)
   return dest;
 }
 
-void TimeSeriesSet::loadData(const string& filePath, int maxNumRow,
-                             int startCol, const string& separators)
+/**
+ * Reads bytes [begin, end) of a file in large blocks and calls onLine with the
+ * beginning and end of every line in that range, excluding the line terminator.
+ * The last line does not need a terminator. Lines are never copied out of the
+ * read buffer. Reading stops early if onLine returns false.
+ */
+template <typename F>
+void forEachLine(std::ifstream& f, std::streamoff begin, std::streamoff end, F onLine)
 {
-  this->clearData();
+  std::streamoff remaining = end - begin;
+  std::vector<char> buffer((size_t)std::max<std::streamoff>(1, std::min<std::streamoff>(READ_BUFFER_SIZE, remaining)));
+  size_t filled = 0;
 
-  std::ifstream f(filePath);
-  if (!f.is_open())
+  f.seekg(begin);
+  while (true)
   {
-    f.close();
-    throw OnexException(string("Cannot open ") + filePath);
+    // A line longer than the buffer is still being read
+    if (filled == buffer.size()) {
+      buffer.resize(buffer.size() * 2);
+    }
+
+    size_t toRead = (size_t)std::min<std::streamoff>(buffer.size() - filled, remaining);
+    f.read(buffer.data() + filled, toRead);
+    size_t got = f.gcount();
+    if (f.bad())
+    {
+      throw OnexException("Error while reading file");
+    }
+    filled += got;
+    remaining -= got;
+    bool done = remaining == 0 || got < toRead;
+
+    const char* p = buffer.data();
+    const char* stop = p + filled;
+    const char* newline;
+    while ((newline = (const char*)memchr(p, '\n', stop - p)) != nullptr)
+    {
+      if (!onLine(p, newline)) {
+        return;
+      }
+      p = newline + 1;
+    }
+
+    if (done)
+    {
+      if (p < stop) {
+        onLine(p, stop);
+      }
+      return;
+    }
+
+    filled = stop - p;
+    memmove(buffer.data(), p, filled);
   }
+}
+
+const double EXACT_POWERS_OF_TEN[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
 
-  if (maxNumRow <= 0) {
-    maxNumRow = countNumberOfLines(f);
+/**
+ * Appends the decimal digits starting at c to mantissa and returns the number
+ * of digits consumed. Eight digits are converted at a time with SWAR
+ * arithmetic when they are available.
+ */
+inline int appendDigits(const char*& c, const char* end, uint64_t& mantissa)
+{
+  const char* begin = c;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (end - c >= 8)
+  {
+    uint64_t chunk;
+    memcpy(&chunk, c, 8);
+    // All bytes are in ['0', '9'] iff their high nibbles are 3 and adding 6
+    // to the low nibbles does not carry
+    if (((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+         (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) != 0x3333333333333333ULL) {
+      break;
+    }
+    chunk -= 0x3030303030303030ULL;
+    chunk = chunk * 10 + (chunk >> 8);
+    chunk = (((chunk & 0x000000FF000000FFULL) * 0x000F424000000064ULL) +
+             (((chunk >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >> 32;
+    mantissa = mantissa * 100000000ULL + chunk;
+    c += 8;
   }
-  else {
-    maxNumRow = std::min(maxNumRow, countNumberOfLines(f));
+#endif
+  for (; c < end && (unsigned)(*c - '0') < 10; c++) {
+    mantissa = mantissa * 10 + (*c - '0');
+  }
+  return c - begin;
+}
+
+/**
+ * Parses a plain decimal number, optionally with an exponent, starting at p.
+ *
+ * This covers virtually every value in a dataset file. Only numbers with at
+ * most 19 significant digits whose value can be computed exactly from an
+ * integer mantissa and a power of ten are accepted, so the result is the
+ * correctly rounded value, the same as that of std::stod.
+ *
+ * @return true and moves p past the number if it is accepted, false otherwise
+ */
+inline bool parseDecimal(const char*& p, const char* end, data_t& value)
+{
+  const char* c = p;
+  bool negative = false;
+  if (c < end && (*c == '-' || *c == '+'))
+  {
+    negative = *c == '-';
+    c++;
   }
 
-  int length = -1;
-  string line;
-  boost::char_separator<char> sep(separators.c_str());
-  typedef boost::tokenizer<boost::char_separator<char>> tokenizer;
+  // Leading zeros are not significant
+  const char* zerosBegin = c;
+  while (c < end && *c == '0') {
+    c++;
+  }
+  bool anyDigit = c > zerosBegin;
 
-  this->itemCount = 0;
-  for (int row = 0; row < maxNumRow; row++, this->itemCount++)
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int significantDigits = appendDigits(c, end, mantissa);
+  anyDigit = anyDigit || significantDigits > 0;
+
+  if (c < end && *c == '.')
+  {
+    c++;
+    if (significantDigits == 0)
+    {
+      const char* fractionZerosBegin = c;
+      while (c < end && *c == '0') {
+        c++;
+      }
+      exponent -= c - fractionZerosBegin;
+      anyDigit = anyDigit || c > fractionZerosBegin;
+    }
+    int fractionDigits = appendDigits(c, end, mantissa);
+    significantDigits += fractionDigits;
+    exponent -= fractionDigits;
+    anyDigit = anyDigit || fractionDigits > 0;
+  }
+  if (!anyDigit || significantDigits > 19) {
+    return false;
+  }
+
+  if (c < end && (*c == 'e' || *c == 'E'))
+  {
+    c++;
+    bool negativeExponent = false;
+    if (c < end && (*c == '-' || *c == '+'))
+    {
+      negativeExponent = *c == '-';
+      c++;
+    }
+    const char* exponentBegin = c;
+    int e = 0;
+    for (; c < end && (unsigned)(*c - '0') < 10 && c - exponentBegin < 9; c++) {
+      e = e * 10 + (*c - '0');
+    }
+    if (c == exponentBegin) {
+      return false;
+    }
+    exponent += negativeExponent ? -e : e;
+  }
+
+  if (mantissa == 0) {
+    exponent = 0;
+  }
+  if (mantissa > (1ULL << 53) || exponent < -22 || exponent > 22) {
+    return false;
+  }
+
+  double v = (double)mantissa;
+  v = exponent < 0 ? v / EXACT_POWERS_OF_TEN[-exponent] : v * EXACT_POWERS_OF_TEN[exponent];
+  value = (data_t)(negative ? -v : v);
+  p = c;
+  return true;
+}
+
+/**
+ * Parses a token that has no leading or trailing whitespace with strtod. This
+ * handles what parseDecimal does not (long mantissas, huge exponents, inf, nan,
+ * hex...) the same way std::stod does.
+ *
+ * @return false if the token is not a number
+ * @throw OnexException if the value is out of range
+ */
+bool parseValueSlow(const char* begin, const char* end, data_t& value)
+{
+  string token(begin, end);
+  char* parsedEnd;
+  errno = 0;
+  double v = strtod(token.c_str(), &parsedEnd);
+  if (token.empty() || parsedEnd != token.c_str() + token.size()) {
+    return false;
+  }
+  if (errno == ERANGE)
   {
-    // Read and process line by line
-    if (getline(f, line))
+    throw OnexException("Values are out of range");
+  }
+  value = (data_t)v;
+  return true;
+}
+
+/**
+ * Splits a line into tokens separated by any of the separator characters and
+ * parses the values of columns [startCol, maxCol) into out. Empty tokens are
+ * skipped and whitespace around a value is ignored. If out is nullptr, the
+ * columns are only counted.
+ *
+ * @return the number of columns in the line
+ * @throw OnexException if a value cannot be parsed
+ */
+int parseLine(const char* p, const char* end, const bool* isSeparator,
+              int startCol, int maxCol, data_t* out)
+{
+  int col = 0;
+  while (true)
+  {
+    while (p < end && isSeparator[(unsigned char)*p]) {
+      p++;
+    }
+    if (p == end) {
+      break;
+    }
+
+    if (!out || col < startCol || col >= maxCol)
     {
-      tokenizer tokens(line, sep);
+      while (p < end && !isSeparator[(unsigned char)*p]) {
+        p++;
+      }
+      col++;
+      continue;
+    }
+
+    while (p < end && !isSeparator[(unsigned char)*p] && isspace((unsigned char)*p)) {
+      p++;
+    }
+    const char* tokenBegin = p;
+    data_t& value = out[col - startCol];
+    bool parsed = parseDecimal(p, end, value);
+
+    // Whatever follows the number in this token must be whitespace
+    const char* tokenEnd = p;
+    while (p < end && !isSeparator[(unsigned char)*p])
+    {
+      if (!isspace((unsigned char)*p)) {
+        parsed = false;
+        tokenEnd = p + 1;
+      }
+      p++;
+    }
+    if (!parsed && !parseValueSlow(tokenBegin, tokenEnd, value))
+    {
+      throw OnexException("Dataset file contains unparsable text");
+    }
+    col++;
+  }
+  return col;
+}
+
+/**
+ * Finds the beginning of the first line that starts at or after offset.
+ */
+std::streamoff findLineStart(std::ifstream& f, std::streamoff offset, std::streamoff fileSize)
+{
+  if (offset <= 0) {
+    return 0;
+  }
+  // Start one byte early so that an offset right after a newline is kept
+  std::streamoff pos = offset - 1;
+  char block[1 << 16];
+  f.clear();
+  f.seekg(pos);
+  while (pos < fileSize)
+  {
+    f.read(block, std::min<std::streamoff>(sizeof(block), fileSize - pos));
+    size_t got = f.gcount();
+    if (got == 0) {
+      break;
+    }
+    const char* newline = (const char*)memchr(block, '\n', got);
+    if (newline) {
+      return pos + (newline - block) + 1;
+    }
+    pos += got;
+  }
+  return fileSize;
+}
+
+/**
+ * Counts the lines in bytes [begin, end) of a file. A last line without a
+ * terminator is counted too.
+ */
+int countLines(std::ifstream& f, std::streamoff begin, std::streamoff end)
+{
+  int lines = 0;
+  char block[1 << 16];
+  char last = '\n';
+  f.seekg(begin);
+  for (std::streamoff pos = begin; pos < end; )
+  {
+    f.read(block, std::min<std::streamoff>(sizeof(block), end - pos));
+    size_t got = f.gcount();
+    if (got == 0) {
+      break;
+    }
+    for (const char* p = block; (p = (const char*)memchr(p, '\n', block + got - p)) != nullptr; p++) {
+      lines++;
+    }
+    last = block[got - 1];
+    pos += got;
+  }
+  return lines + (last != '\n');
+}
+
+/**
+ * Loads a dataset file on the calling thread. Storage grows geometrically
+ * since the number of rows is not known in advance.
+ */
+data_t* loadRowsSerial(std::ifstream& f, std::streamoff fileSize, const bool* isSeparator,
+                       int maxNumRow, int startCol, int& rows, int& length)
+{
+  int columns = -1;
+  int rowCapacity = 0;
+  data_t* rowData = nullptr;
+  rows = 0;
+  length = 0;
+
+  try
+  {
+    forEachLine(f, 0, fileSize, [&](const char* begin, const char* end) -> bool
+    {
+      if (maxNumRow > 0 && rows >= maxNumRow) {
+        return false;
+      }
 
       // Number of columns in the first line is assumed to be number of columns of
       // the whole dataset
-      if (row == 0)
+      if (columns < 0)
       {
-        // If this is the first row, set length of each row to length of this row
-        length = std::distance(tokens.begin(), tokens.end());
-        this->data = new data_t[maxNumRow * length];
-        memset(this->data, 0, maxNumRow * length * sizeof(data_t*));
+        columns = parseLine(begin, end, isSeparator, startCol, 0, nullptr);
+        if (columns <= startCol)
+        {
+          throw OnexException("No values found after the start column");
+        }
+        length = columns - startCol;
 
+        // Guess the number of rows from the size of the first one. The storage
+        // grows geometrically if the guess is too small.
+        std::streamoff guess = fileSize / (end - begin + 1) + 1;
+        if (maxNumRow > 0) {
+          guess = std::min<std::streamoff>(guess, maxNumRow);
+        }
+        rowCapacity = (int)std::min<std::streamoff>(guess, std::numeric_limits<int>::max() / length);
+        rowData = new data_t[(size_t)rowCapacity * length];
       }
-      else if (length != std::distance(tokens.begin(), tokens.end()))
+
+      if (rows == rowCapacity)
+      {
+        int newCapacity = rowCapacity * 2;
+        if (maxNumRow > 0) {
+          newCapacity = std::min(newCapacity, maxNumRow);
+        }
+        data_t* newData = new data_t[(size_t)newCapacity * length];
+        memcpy(newData, rowData, (size_t)rows * length * sizeof(data_t));
+        delete[] rowData;
+        rowData = newData;
+        rowCapacity = newCapacity;
+      }
+
+      if (parseLine(begin, end, isSeparator, startCol, columns,
+                    rowData + (size_t)rows * length) != columns)
       {
-        f.close();
-        this->clearData();
         throw OnexException("File contains time series with inconsistent lengths");
       }
+      rows++;
+      return true;
+    });
+  }
+  catch (...)
+  {
+    delete[] rowData;
+    throw;
+  }
+
+  // Give back the unused part of the storage
+  if (rows < rowCapacity)
+  {
+    data_t* newData = new data_t[(size_t)rows * length];
+    memcpy(newData, rowData, (size_t)rows * length * sizeof(data_t));
+    delete[] rowData;
+    rowData = newData;
+  }
+  return rowData;
+}
+
+/**
+ * Loads a dataset file using several threads.
+ *
+ * The file is split into byte ranges that begin right after a newline. The
+ * lines in each range are counted first, which only needs memchr, so that
+ * every range can then be parsed straight into its own slice of the storage.
+ * Errors are reported for the earliest range that has one, so the first bad
+ * row in the file is the one reported, as in the serial loader.
+ */
+data_t* loadRowsParallel(const string& filePath, std::streamoff fileSize, const bool* isSeparator,
+                         int maxNumRow, int startCol, int numChunks, int numThreads,
+                         int& rows, int& length)
+{
+  std::ifstream f(filePath, std::ios::binary);
+  string firstLine;
+  std::getline(f, firstLine);
+  int columns = parseLine(firstLine.data(), firstLine.data() + firstLine.size(),
+                          isSeparator, startCol, 0, nullptr);
+  if (columns <= startCol)
+  {
+    throw OnexException("No values found after the start column");
+  }
+  length = columns - startCol;
+
+  vector<std::streamoff> bounds(numChunks + 1);
+  for (int k = 0; k < numChunks; k++) {
+    bounds[k] = findLineStart(f, fileSize / numChunks * k, fileSize);
+  }
+  bounds[numChunks] = fileSize;
+
+  vector<int> firstRow(numChunks + 1, 0);
+  parallelFor(numChunks, numThreads, [&](int k) {
+    std::ifstream chunk(filePath, std::ios::binary);
+    firstRow[k + 1] = countLines(chunk, bounds[k], bounds[k + 1]);
+  });
+  for (int k = 0; k < numChunks; k++) {
+    firstRow[k + 1] += firstRow[k];
+  }
 
-      int col = 0;
-      for (tokenizer::iterator tok_iter = tokens.begin();
-           tok_iter != tokens.end(); tok_iter++, col++)
+  rows = firstRow[numChunks];
+  if (maxNumRow > 0) {
+    rows = std::min(rows, maxNumRow);
+  }
+
+  data_t* rowData = new data_t[(size_t)rows * length];
+  try
+  {
+    parallelFor(numChunks, numThreads, [&](int k) {
+      int row = firstRow[k];
+      if (row >= rows) {
+        return;
+      }
+      std::ifstream chunk(filePath, std::ios::binary);
+      forEachLine(chunk, bounds[k], bounds[k + 1], [&](const char* begin, const char* end) -> bool
       {
-        // Only read columns from startCol and after
-        if (col >= startCol)
+        if (parseLine(begin, end, isSeparator, startCol, columns,
+                      rowData + (size_t)row * length) != columns)
         {
-          try
-          {
-            data[row * (length - startCol) + (col - startCol)] = (data_t)std::stod(*tok_iter);
-          }
-          catch (const std::invalid_argument& e)
-          {
-            f.close();
-            this->clearData();
-            throw OnexException("Dataset file contains unparsable text");
-          }
-          catch (const std::out_of_range& e)
-          {
-            f.close();
-            this->clearData();
-            throw OnexException("Values are out of range");
-          }
+          throw OnexException("File contains time series with inconsistent lengths");
         }
-      }
+        return ++row < rows;
+      });
+    });
+  }
+  catch (...)
+  {
+    delete[] rowData;
+    throw;
+  }
+  return rowData;
+}
+
+void TimeSeriesSet::loadData(const string& filePath, int maxNumRow,
+                             int startCol, const string& separators, int numThreads)
+{
+  this->clearData();
+
+  std::ifstream f(filePath, std::ios::binary);
+  if (!f.is_open())
+  {
+    throw OnexException(string("Cannot open ") + filePath);
+  }
+  f.seekg(0, std::ios::end);
+  std::streamoff fileSize = f.tellg();
+
+  char magic[8] = {};
+  f.seekg(0);
+  f.read(magic, sizeof(magic));
+  bool isBinary = memcmp(magic, BINARY_DATASET_MAGIC, 8) == 0;
+  bool isNpy = memcmp(magic, NPY_MAGIC, 6) == 0;
+  if (isBinary || isNpy)
+  {
+    if (startCol > 0)
+    {
+      throw OnexException("Start column is not supported for binary datasets");
+    }
+    f.close();
+    if (isBinary) {
+      this->loadBinaryData(filePath, maxNumRow);
     }
     else {
-      break;
+      this->loadNpyData(filePath, maxNumRow);
     }
+    return;
   }
+  f.clear();
 
-  if (f.bad())
-  {
-    f.close();
-    this->clearData();
-    throw OnexException("Error while reading file");
+  bool isSeparator[256] = {};
+  for (unsigned char c : separators) {
+    isSeparator[c] = true;
   }
 
-  this->itemLength = length - startCol;
-  this->filePath = filePath;
+  // Small files are not worth splitting
+  numThreads = getNumberOfThreads(numThreads);
+  int numChunks = (int)std::min<std::streamoff>(numThreads, fileSize / MIN_CHUNK_SIZE);
 
-  f.close();
+  int rows, length;
+  if (numChunks > 1) {
+    this->data = loadRowsParallel(filePath, fileSize, isSeparator, maxNumRow, startCol,
+                                  numChunks, numThreads, rows, length);
+  }
+  else {
+    this->data = loadRowsSerial(f, fileSize, isSeparator, maxNumRow, startCol, rows, length);
+  }
+
+  this->itemCount = rows;
+  this->itemLength = rows > 0 ? length : 0;
+  this->filePath = filePath;
 }
 
 void TimeSeriesSet::saveData(const string& filePath, char separator) const
@@ -172,21 +639,260 @@ void TimeSeriesSet::saveData(const string& filePath, char separator) const
     f.close();
     throw OnexException(string("Cannot open ") + filePath);
   }
+  f.precision(std::numeric_limits<data_t>::max_digits10);
   for (int i = 0; i < itemCount; i++) {
     for (int j = 0; j < itemLength; j++) {
       f << data[i * itemLength + j] << separator;
     }
-    f << std::endl;
+    f << '\n';
+  }
+  f.close();
+  if (f.fail())
+  {
+    throw OnexException(string("Error while writing ") + filePath);
+  }
+}
+
+void TimeSeriesSet::saveBinaryData(const string& filePath) const
+{
+  std::ofstream f(filePath, std::ios::binary);
+  if (!f.is_open())
+  {
+    throw OnexException(string("Cannot open ") + filePath);
   }
+
+  binary_dataset_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BINARY_DATASET_MAGIC, sizeof(header.magic));
+  header.version = BINARY_DATASET_VERSION;
+  header.headerSize = sizeof(header);
+  header.itemCount = this->itemCount;
+  header.itemLength = this->itemLength;
+  header.valueSize = sizeof(data_t);
+  header.flags = this->normalized ? BINARY_DATASET_NORMALIZED : 0;
+  header.normalizationMin = this->normalizationMin;
+  header.normalizationMax = this->normalizationMax;
+
+  f.write((const char*)&header, sizeof(header));
+  f.write((const char*)this->data, (std::streamsize)this->itemCount * this->itemLength * sizeof(data_t));
   f.close();
+  if (f.fail())
+  {
+    throw OnexException(string("Error while writing ") + filePath);
+  }
 }
 
-void TimeSeriesSet::clearData()
+void TimeSeriesSet::useMappedValues(MappedFile* file, size_t offset, int valueSize,
+                                    int count, int length)
+{
+  size_t numValues = (size_t)count * length;
+  if (offset > file->getSize() || (file->getSize() - offset) / valueSize < numValues)
+  {
+    delete file;
+    throw OnexException("File is shorter than its header says");
+  }
+
+  if (numValues == 0) {
+    delete file;
+  }
+  else if (valueSize == sizeof(data_t) && offset % alignof(data_t) == 0)
+  {
+    this->mappedFile = file;
+    this->data = (data_t*)(file->getData() + offset);
+  }
+  else
+  {
+    this->data = new data_t[numValues];
+    readValues(file->getData() + offset, valueSize, this->data, numValues);
+    delete file;
+  }
+
+  this->itemCount = numValues > 0 ? count : 0;
+  this->itemLength = numValues > 0 ? length : 0;
+}
+
+void TimeSeriesSet::loadBinaryData(const string& filePath, int maxNumRow)
+{
+  this->clearData();
+
+  MappedFile* file = new MappedFile(filePath);
+  binary_dataset_header_t header;
+  if (file->getSize() < sizeof(header))
+  {
+    delete file;
+    throw OnexException("File is not a binary dataset");
+  }
+  memcpy(&header, file->getData(), sizeof(header));
+
+  string error;
+  if (memcmp(header.magic, BINARY_DATASET_MAGIC, sizeof(header.magic)) != 0) {
+    error = "File is not a binary dataset";
+  }
+  else if (header.version != BINARY_DATASET_VERSION) {
+    error = "Unsupported binary dataset version " + std::to_string(header.version);
+  }
+  else if (header.valueSize != sizeof(float) && header.valueSize != sizeof(double)) {
+    error = "Unsupported value size in binary dataset";
+  }
+  else if (header.headerSize < sizeof(header) ||
+           header.itemCount > (uint64_t)std::numeric_limits<int>::max() ||
+           header.itemLength > (uint64_t)std::numeric_limits<int>::max()) {
+    error = "Binary dataset has an invalid header";
+  }
+  if (!error.empty())
+  {
+    delete file;
+    throw OnexException(error);
+  }
+
+  int count = (int)header.itemCount;
+  if (maxNumRow > 0) {
+    count = std::min(count, maxNumRow);
+  }
+  this->useMappedValues(file, header.headerSize, header.valueSize, count, (int)header.itemLength);
+
+  this->normalized = (header.flags & BINARY_DATASET_NORMALIZED) != 0;
+  this->normalizationMin = header.normalizationMin;
+  this->normalizationMax = header.normalizationMax;
+  this->filePath = filePath;
+}
+
+/**
+ * Finds the value of a key in the header dictionary of a .npy file and
+ * returns a pointer to its first character, or nullptr if the key is missing.
+ */
+const char* findNpyValue(const string& header, const char* key)
+{
+  size_t pos = header.find(string("'") + key + "'");
+  if (pos == string::npos) {
+    return nullptr;
+  }
+  const char* p = header.c_str() + pos + strlen(key) + 2;
+  while (*p == ' ' || *p == ':') {
+    p++;
+  }
+  return p;
+}
+
+void TimeSeriesSet::loadNpyData(const string& filePath, int maxNumRow)
+{
+  this->clearData();
+
+  MappedFile* file = new MappedFile(filePath);
+  const unsigned char* bytes = (const unsigned char*)file->getData();
+
+  // Magic string, major and minor version, then the length of the header as
+  // a little-endian integer of 2 bytes in version 1 and 4 bytes afterwards
+  size_t offset = 0;
+  string header;
+  if (file->getSize() >= 10 && memcmp(bytes, NPY_MAGIC, 6) == 0)
+  {
+    int major = bytes[6];
+    size_t headerLength = 0;
+    if (major == 1) {
+      headerLength = bytes[8] | (bytes[9] << 8);
+      offset = 10;
+    }
+    else if (file->getSize() >= 12) {
+      headerLength = bytes[8] | (bytes[9] << 8) | (bytes[10] << 16) | ((size_t)bytes[11] << 24);
+      offset = 12;
+    }
+    if (offset > 0 && headerLength <= file->getSize() - offset)
+    {
+      header.assign((const char*)bytes + offset, headerLength);
+      offset += headerLength;
+    }
+  }
+  if (header.empty())
+  {
+    delete file;
+    throw OnexException("File is not a valid .npy file");
+  }
+
+  const char* descr = findNpyValue(header, "descr");
+  const char* fortranOrder = findNpyValue(header, "fortran_order");
+  const char* shape = findNpyValue(header, "shape");
+
+  int valueSize = 0;
+  if (descr && (descr[1] == '<' || descr[1] == '|' || descr[1] == '=') && descr[2] == 'f')
+  {
+    if (strncmp(descr + 3, "4'", 2) == 0) {
+      valueSize = 4;
+    }
+    else if (strncmp(descr + 3, "8'", 2) == 0) {
+      valueSize = 8;
+    }
+  }
+  if (valueSize == 0 || !fortranOrder || strncmp(fortranOrder, "False", 5) != 0 || !shape || *shape != '(')
+  {
+    delete file;
+    throw OnexException("Only C-ordered arrays of little-endian floats are supported in .npy files");
+  }
+
+  vector<long long> dims;
+  for (const char* p = shape + 1; *p && *p != ')'; )
+  {
+    if (isdigit((unsigned char)*p))
+    {
+      char* next;
+      dims.push_back(strtoll(p, &next, 10));
+      p = next;
+    }
+    else {
+      p++;
+    }
+  }
+  if (dims.size() == 1) {
+    dims.insert(dims.begin(), 1);
+  }
+  if (dims.size() != 2 || dims[0] > std::numeric_limits<int>::max() ||
+      dims[1] > std::numeric_limits<int>::max())
+  {
+    delete file;
+    throw OnexException("Only one or two dimensional arrays are supported in .npy files");
+  }
+
+  int count = (int)dims[0];
+  if (maxNumRow > 0) {
+    count = std::min(count, maxNumRow);
+  }
+  this->useMappedValues(file, offset, valueSize, count, (int)dims[1]);
+  this->filePath = filePath;
+}
+
+size_t TimeSeriesSet::getMemoryUsage() const
 {
-  delete[] this->data;
+  size_t bytes = sizeof(*this) + this->filePath.capacity();
+  if (this->data && !this->mappedFile) {
+    bytes += (size_t)this->itemCount * this->itemLength * sizeof(data_t);
+  }
+  return bytes;
+}
+
+size_t TimeSeriesSet::getMappedMemoryUsage() const
+{
+  return this->mappedFile ? this->mappedFile->getSize() : 0;
+}
+
+void TimeSeriesSet::freeData()
+{
+  if (this->mappedFile)
+  {
+    delete this->mappedFile;
+    this->mappedFile = nullptr;
+  }
+  else {
+    delete[] this->data;
+  }
   this->data = nullptr;
+}
+
+void TimeSeriesSet::clearData()
+{
+  this->freeData();
   this->itemCount = 0;
   this->itemLength = 0;
+  this->normalized = false;
 }
 
 TimeSeries TimeSeriesSet::getTimeSeries(int index, int start, int end) const
@@ -289,6 +995,8 @@ std::pair<data_t, data_t> TimeSeriesSet::normalize(void)
     }
   }
   normalized = true;
+  normalizationMin = MIN;
+  normalizationMax = MAX;
   return std::make_pair(MIN, MAX);
 }
 
@@ -304,7 +1012,7 @@ void TimeSeriesSet::PAA(int n)
     doPAA(this->data + ts * this->itemLength, new_data + ts * newItemLength,
       this->itemLength, n);
   }
-  delete this->data;
+  this->freeData();
   this->data = new_data;
   this->itemLength = newItemLength;
 }
@@ -321,4 +1029,84 @@ data_t TimeSeriesSet::distanceBetween(int idx, int start, int length,
   return distance(this->getTimeSeries(idx, start, start + length), other, INF);
 }
 
+candidate_time_series_t TimeSeriesSet::getBestMatchBruteForce(const TimeSeries& query) const
+{
+  if (this->data == nullptr)
+  {
+    throw OnexException("No data to match against");
+  }
+
+  MASS mass(query, this->itemLength);
+  int m = query.getLength();
+  std::vector<data_t> profileA, profileB;
+  candidate_time_series_t best(query, INF);
+
+  for (int idx = 0; idx < this->itemCount; idx += 2)
+  {
+    bool hasPair = idx + 1 < this->itemCount;
+    mass.distanceProfile(this->data + idx * this->itemLength,
+                         hasPair ? this->data + (idx + 1) * this->itemLength : nullptr,
+                         profileA, profileB);
+
+    for (int k = 0; k < (hasPair ? 2 : 1); k++)
+    {
+      const std::vector<data_t>& profile = k == 0 ? profileA : profileB;
+      for (unsigned int start = 0; start < profile.size(); start++)
+      {
+        // Profile values never exceed the true distance, so anything at or
+        // above the best so far can be skipped without verification
+        if (profile[start] > best.dist) {
+          continue;
+        }
+        TimeSeries candidate = this->getTimeSeries(idx + k, start, start + m);
+        candidate_time_series_t c(candidate, pairwiseDistance(candidate, query, best.dist));
+        if (c < best) {
+          best = c;
+        }
+      }
+    }
+  }
+  return best;
+}
+
+std::vector<candidate_time_series_t> TimeSeriesSet::getMatchesWithin(
+  const TimeSeries& query, data_t radius) const
+{
+  if (this->data == nullptr)
+  {
+    throw OnexException("No data to match against");
+  }
+
+  MASS mass(query, this->itemLength);
+  int m = query.getLength();
+  std::vector<data_t> profileA, profileB;
+  std::vector<candidate_time_series_t> matches;
+
+  for (int idx = 0; idx < this->itemCount; idx += 2)
+  {
+    bool hasPair = idx + 1 < this->itemCount;
+    mass.distanceProfile(this->data + idx * this->itemLength,
+                         hasPair ? this->data + (idx + 1) * this->itemLength : nullptr,
+                         profileA, profileB);
+
+    for (int k = 0; k < (hasPair ? 2 : 1); k++)
+    {
+      const std::vector<data_t>& profile = k == 0 ? profileA : profileB;
+      for (unsigned int start = 0; start < profile.size(); start++)
+      {
+        if (profile[start] > radius) {
+          continue;
+        }
+        TimeSeries candidate = this->getTimeSeries(idx + k, start, start + m);
+        data_t dist = pairwiseDistance(candidate, query, INF);
+        if (dist <= radius) {
+          matches.push_back(candidate_time_series_t(candidate, dist));
+        }
+      }
+    }
+  }
+  std::sort(matches.begin(), matches.end());
+  return matches;
+}
+
 } // namespace onex
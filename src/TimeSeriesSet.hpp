@@ -11,6 +11,8 @@ using std::string;
 
 namespace onex {
 
+class MappedFile;
+
 /**
  *  @brief a TimeSeriesSet object contains values and information of a dataset
  *
@@ -28,7 +30,8 @@ public:
    *  Create a TimeSeriestSet object with is an empty string for name
    */
   TimeSeriesSet()
-    : itemLength(0), itemCount(0), normalized(false) {};
+    : itemLength(0), itemCount(0), normalized(false),
+      normalizationMin(0), normalizationMax(0) {};
 
   /**
    *  @brief destructor
@@ -45,19 +48,90 @@ public:
    *  maxNumRow is larger than or equal to the actual number of lines, or maxNumRow is
    *  not positive all lines are read.
    *
+   *  The file is read in a single pass over large blocks and values are parsed
+   *  in place. Empty values between consecutive separators are skipped and
+   *  whitespace around a value is ignored.
+   *
+   *  With more than one thread, the file is split into ranges of lines that
+   *  are parsed concurrently. The result is the same as with a single thread.
+   *
+   *  Binary datasets (see saveBinaryData) and .npy files are recognized by
+   *  their first bytes and loaded with loadBinaryData and loadNpyData.
+   *
    *  @param filePath path to a text file
    *  @param maxNumRow maximum number of rows to be read. If this value is not positive,
    *         all lines are read
    *  @param startCol columns before startCol are discarded
    *  @param separator a string containings possible separator characters for values
    *         in a line
+   *  @param numThreads number of threads used for parsing. If this value is not
+   *         positive, all hardware threads are used
    *
    *  @throw OnexException if cannot read from the given file
    */
-  void loadData(const string& filePath, int maxNumRow, int startCol, const string& separator);
+  void loadData(const string& filePath, int maxNumRow, int startCol, const string& separator,
+                int numThreads = 1);
 
+  /**
+   *  @brief saves data to a text file
+   *
+   *  Each time series is written on its own line. Values are written with
+   *  enough digits to be read back exactly.
+   *
+   *  @param filePath path to the text file
+   *  @param separator character written after each value
+   *
+   *  @throw OnexException if cannot write to the given file
+   */
   void saveData(const string& filePath, char separator) const;
 
+  /**
+   *  @brief saves data to a binary file
+   *
+   *  The file has a fixed-size header with the number and length of the time
+   *  series, the size of a value, and the normalization state and range,
+   *  followed by the values in row-major order. The values start at an
+   *  aligned offset so that the file can be mapped into memory and used
+   *  directly. See src/README.md for the exact layout.
+   *
+   *  @param filePath path to the binary file
+   *
+   *  @throw OnexException if cannot write to the given file
+   */
+  void saveBinaryData(const string& filePath) const;
+
+  /**
+   *  @brief loads data from a binary file written by saveBinaryData
+   *
+   *  The file is mapped into memory and its values are used in place, so
+   *  loading takes constant time and values are read from disk when they are
+   *  first accessed. If the file was written with a different precision, the
+   *  values are converted into memory instead.
+   *
+   *  @param filePath path to the binary file
+   *  @param maxNumRow maximum number of time series to use. If this value is
+   *         not positive, all time series are used
+   *
+   *  @throw OnexException if the file cannot be read or is not a valid binary dataset
+   */
+  void loadBinaryData(const string& filePath, int maxNumRow = 0);
+
+  /**
+   *  @brief loads data from a NumPy .npy file
+   *
+   *  The array must be a one or two dimensional C-ordered array of
+   *  little-endian 32-bit or 64-bit floats. Each row is a time series. Like
+   *  loadBinaryData, the file is mapped into memory and used in place when
+   *  its values have the same precision as data_t.
+   *
+   *  @param filePath path to the .npy file
+   *  @param maxNumRow maximum number of time series to use. If this value is
+   *         not positive, all time series are used
+   *
+   *  @throw OnexException if the file cannot be read or has an unsupported array type
+   */
+  void loadNpyData(const string& filePath, int maxNumRow = 0);
+
   /**
    * @brief clears all data
    */
@@ -114,8 +188,33 @@ public:
   */
   bool isNormalized() { return normalized; }
 
+  /**
+   *  @brief gets the minimum and maximum values of the dataset before it
+   *         was normalized
+   *
+   *  @return a pair (min, max). Only meaningful if the dataset is normalized
+   */
+  std::pair<data_t, data_t> getNormalizationRange() const
+  {
+    return std::make_pair(normalizationMin, normalizationMax);
+  }
+
   void PAA(int n);
 
+  /**
+   *  @brief gets the number of bytes allocated by this dataset
+   *
+   *  Values mapped from a binary dataset file are not allocated and are
+   *  counted by getMappedMemoryUsage instead.
+   */
+  size_t getMemoryUsage() const;
+
+  /**
+   *  @brief gets the size of the file mapped for the values, or 0 if the
+   *         values are in allocated memory
+   */
+  size_t getMappedMemoryUsage() const;
+
   /**
     *  @brief calculates the distance between a subsequence of a series in this dataset to
     *   input timeseries
@@ -131,7 +230,35 @@ public:
     */
   data_t distanceBetween(int idx, int start, int length,
       const TimeSeries& other, const string& distance_name);
-      
+
+  /**
+   *  @brief finds the sub-sequence closest to a query by Euclidean distance
+   *
+   *  Every sub-sequence with the same length as the query is considered. The
+   *  distance profile of the query against each time series is computed with
+   *  MASS in O(n log n), and only the starting positions that the profile cannot
+   *  rule out are verified with pairwiseDistance.
+   *
+   *  @param query the query. It must not be longer than the time series
+   *  @return the closest sub-sequence and its distance to the query
+   *
+   *  @throw OnexException if no data is loaded or the query is too long
+   */
+  candidate_time_series_t getBestMatchBruteForce(const TimeSeries& query) const;
+
+  /**
+   *  @brief finds all sub-sequences within a Euclidean distance from a query
+   *
+   *  This is the range query counterpart of getBestMatchBruteForce.
+   *
+   *  @param query the query. It must not be longer than the time series
+   *  @param radius maximum distance of a returned sub-sequence
+   *  @return the matching sub-sequences and their distances, sorted by distance
+   *
+   *  @throw OnexException if no data is loaded or the query is too long
+   */
+  std::vector<candidate_time_series_t> getMatchesWithin(const TimeSeries& query, data_t radius) const;
+
   /**
    *  @brief check if data is loaded
    */
@@ -143,8 +270,17 @@ protected:
   int itemCount;
 
 private:
+  void freeData();
+  void useMappedValues(MappedFile* file, size_t offset, int valueSize,
+                       int count, int length);
+
   string filePath;
   bool normalized;
+  data_t normalizationMin;
+  data_t normalizationMax;
+
+  // Set if data points into a mapped file instead of memory owned by this object
+  MappedFile* mappedFile = nullptr;
 };
 
 } // namespace onex
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <map>
 #include <vector>
 #include <iostream>
@@ -7,6 +8,7 @@
 #include "Exception.hpp"
 #include "TimeSeries.hpp"
 #include "distance/Distance.hpp"
+#include "lib/trillionDTW.h"
 
 using std::string;
 using std::vector;
@@ -43,14 +45,95 @@ data_t _euc_inorm(data_t dropout, const TimeSeries& t_1, const TimeSeries& t_2)
   return dropout * dropout * std::max(t_1.getLength(), t_2.getLength());
 }
 
+// length is the length of the longer time series
+data_t _euc_norm_dtw(data_t total, int length)
+{
+  return sqrt(total) / (2 * length);
+}
+
 data_t _euc_norm_dtw(data_t total, const TimeSeries& t_1, const TimeSeries& t_2)
 {
-  return sqrt(total) / (2 * std::max(t_1.getLength(), t_2.getLength()));
+  return _euc_norm_dtw(total, std::max(t_1.getLength(), t_2.getLength()));
+}
+
+data_t _euc_inorm_dtw(data_t dropout, int length)
+{
+  return pow(dropout * 2 * length, 2);
 }
 
 data_t _euc_inorm_dtw(data_t dropout, const TimeSeries& t_1, const TimeSeries& t_2)
 {
-  return pow(dropout * 2 * std::max(t_1.getLength(), t_2.getLength()), 2);
+  return _euc_inorm_dtw(dropout, std::max(t_1.getLength(), t_2.getLength()));
+}
+
+// ONEX_TARGET_CLONES compiles a function once per instruction set and picks
+// one at load time. ONEX_TARGET_AVX2 compiles it for AVX2 only, so it must
+// not be called unless ONEX_HAS_AVX2
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && !defined(__clang__)
+#define ONEX_TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#define ONEX_TARGET_AVX2 __attribute__((target("avx2")))
+#define ONEX_HAS_AVX2 __builtin_cpu_supports("avx2")
+#else
+#define ONEX_TARGET_CLONES
+#define ONEX_TARGET_AVX2
+#define ONEX_HAS_AVX2 false
+#endif
+
+// Shorter warped distances are as fast row by row
+#define WAVEFRONT_MIN_LENGTH 4
+
+/**
+ *  @brief returns the cost of the warped distance between a and b, or INF
+ *         if it is abandoned
+ *
+ *  The cells of an anti-diagonal i + j = d only depend on the two diagonals
+ *  before it, so a whole diagonal of the band is computed by the same
+ *  instructions. Diagonals are stored by row, with b reversed so that the
+ *  values of a diagonal are contiguous in both series. A warping path
+ *  crosses one of any two consecutive diagonals, so the computation is
+ *  abandoned when both are above the dropout.
+ */
+ONEX_TARGET_AVX2
+data_t _warped_distance_wavefront(const data_t* a, int m, const data_t* b, int n, int r, data_t idropout)
+{
+  if (m - n > r || n - m > r) {
+    return INF;
+  }
+  vector<data_t> reversed(b, b + n);
+  std::reverse(reversed.begin(), reversed.end());
+  // Entry 0 of each buffer is row -1, which is always INF
+  vector<data_t> buffers(3 * (m + 2), INF);
+  data_t* prev2 = buffers.data() + 1;
+  data_t* prev1 = prev2 + m + 2;
+  data_t* cur = prev1 + m + 2;
+  const data_t* rb = reversed.data() + n - 1;
+
+  cur[0] = (a[0] - b[0]) * (a[0] - b[0]);
+  data_t prevMin = cur[0];
+  for (int d = 1; d <= m + n - 2; d++)
+  {
+    std::swap(prev2, prev1);
+    std::swap(prev1, cur);
+    // Rows of the diagonal that are inside the matrix and the band
+    int lo = max(max(0, d - (n - 1)), (d - r + 1) / 2);
+    int hi = min(min(m - 1, d), (d + r) / 2);
+    data_t diagMin = INF;
+    for (int i = lo; i <= hi; i++)
+    {
+      data_t minPrev = prev2[i - 1] < prev1[i - 1] ? prev2[i - 1] : prev1[i - 1];
+      minPrev = prev1[i] < minPrev ? prev1[i] : minPrev;
+      data_t diff = a[i] - rb[i - d];
+      cur[i] = minPrev + diff * diff;
+      diagMin = cur[i] < diagMin ? cur[i] : diagMin;
+    }
+    cur[lo - 1] = INF;
+    cur[hi + 1] = INF;
+    if (prevMin > idropout && diagMin > idropout) {
+      return INF;
+    }
+    prevMin = diagMin;
+  }
+  return cur[m - 1];
 }
 
 data_t warpedDistance(const TimeSeries& a, const TimeSeries& b, data_t dropout)
@@ -66,6 +149,10 @@ data_t warpedDistance(const TimeSeries& a, const TimeSeries& b, data_t dropout)
     return _euc_norm_dtw(_euc(a[0], b[0]), a, b);
   }
 
+  if (m > 1 && n > 1 && max(m, n) >= WAVEFRONT_MIN_LENGTH && ONEX_HAS_AVX2) {
+    return _euc_norm_dtw(_warped_distance_wavefront(&a[0], m, &b[0], n, r, idropout), a, b);
+  }
+
   // create cost matrix
   vector< vector< data_t >> cost(m, vector< data_t >(n));
 
@@ -123,6 +210,240 @@ data_t warpedDistance(const TimeSeries& a, const TimeSeries& b, data_t dropout)
   return _euc_norm_dtw(result, a, b);
 }
 
+vector<data_t> warpedDistancePrefixes(const TimeSeries& a, const TimeSeries& b,
+                                      const vector<int>& lengths, data_t dropout)
+{
+  int m = a.getLength();
+  vector<data_t> result(lengths.size(), INF);
+
+  if (m == 1)
+  {
+    // warpedDistance fills the first row up to column 2r
+    for (unsigned int k = 0; k < lengths.size(); k++)
+    {
+      if (lengths[k] - 1 <= 2 * calculateWarpingBandSize(lengths[k])) {
+        data_t total = 0;
+        for (int j = 0; j < lengths[k]; j++) {
+          total += _euc(a[0], b[j]);
+        }
+        result[k] = _euc_norm_dtw(total, lengths[k]);
+      }
+    }
+    return result;
+  }
+
+  // Prefixes that share a band size share the columns of the cost matrix
+  vector<std::pair<int, int> > order;
+  for (unsigned int k = 0; k < lengths.size(); k++) {
+    order.push_back(make_pair(calculateWarpingBandSize(max(m, lengths[k])), lengths[k]));
+  }
+  std::sort(order.begin(), order.end());
+
+  // Only two columns are kept. Cells outside the band are INF
+  vector<data_t> prev(m, INF), cur(m, INF);
+  for (unsigned int first = 0, last; first < order.size(); first = last)
+  {
+    int r = order[first].first;
+    int n = order[first].second;
+    for (last = first; last < order.size() && order[last].first == r; last++) {
+      n = order[last].second;
+    }
+    data_t idropout = _euc_inorm_dtw(dropout, max(m, n));
+
+    unsigned int next = first;
+    for (int j = 0; j < n && next < last; j++)
+    {
+      int lo = max(j - r, 0);
+      int hi = min(j + r, m - 1);
+      if (lo > hi) {
+        // The last row is behind the band
+        break;
+      }
+      if (lo > 0) {
+        cur[lo - 1] = INF;
+      }
+      data_t bestSoFar = INF;
+      for (int i = lo; i <= hi; i++)
+      {
+        data_t minPrev;
+        if (i == 0) {
+          minPrev = j == 0 ? 0 : prev[0];
+        }
+        else if (j == 0) {
+          minPrev = cur[i - 1];
+        }
+        else {
+          minPrev = min(min(prev[i - 1], prev[i]), cur[i - 1]);
+        }
+        cur[i] = minPrev + _euc(a[i], b[j]);
+        bestSoFar = min(bestSoFar, cur[i]);
+      }
+      if (hi + 1 < m) {
+        cur[hi + 1] = INF;
+      }
+
+      // Every warping path of a longer prefix crosses this column
+      if (bestSoFar > idropout) {
+        break;
+      }
+      if (next < last && order[next].second == j + 1)
+      {
+        data_t total = hi == m - 1 ? cur[m - 1] : INF;
+        if (j == 0 && hi < m - 1 && m - 1 <= 2 * r) {
+          // warpedDistance fills the first column up to row 2r
+          total = cur[hi];
+          for (int i = hi + 1; i < m; i++) {
+            total += _euc(a[i], b[0]);
+          }
+        }
+        for (unsigned int k = 0; k < lengths.size(); k++)
+        {
+          if (lengths[k] == j + 1) {
+            result[k] = _euc_norm_dtw(total, max(m, j + 1));
+          }
+        }
+        while (next < last && order[next].second == j + 1) {
+          next++;
+        }
+      }
+      prev.swap(cur);
+    }
+  }
+  return result;
+}
+
+/**
+ *  @brief fills totals with the cost of the warped distance between a and
+ *         each lane of b, or INF for the lanes that are abandoned
+ *
+ *  b holds WARPED_DISTANCE_LANES series of length n, interleaved value by
+ *  value, so the lanes of a cell are next to each other and are computed
+ *  by the same instructions. Lanes whose limit is negative start abandoned.
+ */
+ONEX_TARGET_CLONES
+void _warped_distance_lanes(const data_t* a, int m, const data_t* b, int n, int r,
+                            const data_t* limit, data_t* totals)
+{
+  const int L = WARPED_DISTANCE_LANES;
+  vector<data_t> prevRow(n * L, INF), curRow(n * L, INF);
+  data_t* prev = prevRow.data();
+  data_t* cur = curRow.data();
+  bool alive[L];
+  int aliveCount = 0;
+  for (int l = 0; l < L; l++) {
+    alive[l] = limit[l] >= 0;
+    aliveCount += alive[l];
+  }
+
+  for (int i = 0; i < m && aliveCount > 0; i++)
+  {
+    int lo = max(i - r, 0);
+    int hi = min(i + r, n - 1);
+    if (lo > hi) {
+      break;
+    }
+    data_t rowMin[L];
+    for (int l = 0; l < L; l++) {
+      rowMin[l] = INF;
+    }
+    if (lo > 0) {
+      for (int l = 0; l < L; l++) {
+        cur[(lo - 1) * L + l] = INF;
+      }
+    }
+    int j = lo;
+    if (lo == 0)
+    {
+      // The first cell only follows the cell above it, or nothing
+      for (int l = 0; l < L; l++) {
+        data_t diff = a[i] - b[l];
+        data_t c = (i == 0 ? 0 : prev[l]) + diff * diff;
+        cur[l] = c;
+        rowMin[l] = c < rowMin[l] ? c : rowMin[l];
+      }
+      j = 1;
+    }
+    for (; j <= hi; j++)
+    {
+      const data_t* bj = b + j * L;
+      const data_t* p = prev + j * L;
+      data_t* c = cur + j * L;
+      for (int l = 0; l < L; l++) {
+        data_t minPrev = p[l - L] < p[l] ? p[l - L] : p[l];
+        minPrev = c[l - L] < minPrev ? c[l - L] : minPrev;
+        data_t diff = a[i] - bj[l];
+        c[l] = minPrev + diff * diff;
+        rowMin[l] = c[l] < rowMin[l] ? c[l] : rowMin[l];
+      }
+    }
+    if (hi + 1 < n) {
+      for (int l = 0; l < L; l++) {
+        cur[(hi + 1) * L + l] = INF;
+      }
+    }
+    for (int l = 0; l < L; l++)
+    {
+      if (alive[l] && rowMin[l] > limit[l]) {
+        alive[l] = false;
+        aliveCount--;
+      }
+    }
+    std::swap(prev, cur);
+  }
+
+  for (int l = 0; l < L; l++) {
+    totals[l] = alive[l] && m - 1 <= n - 1 + r && n - 1 <= m - 1 + r ? prev[(n - 1) * L + l] : INF;
+  }
+}
+
+vector<data_t> warpedDistanceBatch(const TimeSeries& a, const vector<const TimeSeries*>& b, data_t dropout)
+{
+  const int L = WARPED_DISTANCE_LANES;
+  vector<data_t> result(b.size(), INF);
+  if (b.empty()) {
+    return result;
+  }
+  int m = a.getLength();
+  int n = b[0]->getLength();
+  if (m == 1 || n == 1)
+  {
+    // Single values take the fast path of warpedDistance
+    for (unsigned int k = 0; k < b.size(); k++) {
+      result[k] = warpedDistance(a, *b[k], dropout);
+    }
+    return result;
+  }
+  int r = calculateWarpingBandSize(max(m, n));
+  data_t idropout = _euc_inorm_dtw(dropout, max(m, n));
+
+  vector<data_t> values(n * L);
+  data_t limit[L], totals[L];
+  for (unsigned int first = 0; first < b.size(); first += L)
+  {
+    int count = min<int>(L, b.size() - first);
+    if (count == 1)
+    {
+      // A single candidate is faster by diagonals than in a lane
+      result[first] = warpedDistance(a, *b[first], dropout);
+      continue;
+    }
+    for (int l = 0; l < L; l++)
+    {
+      // Unused lanes repeat the first candidate and start abandoned
+      const TimeSeries& candidate = *b[first + (l < count ? l : 0)];
+      for (int j = 0; j < n; j++) {
+        values[j * L + l] = candidate[j];
+      }
+      limit[l] = l < count ? idropout : -1;
+    }
+    _warped_distance_lanes(&a[0], m, values.data(), n, r, limit, totals);
+    for (int l = 0; l < count; l++) {
+      result[first + l] = _euc_norm_dtw(totals[l], max(m, n));
+    }
+  }
+  return result;
+}
+
 double warpingBandRatio = 0.1;
 
 void setWarpingBandRatio(double ratio) {
@@ -193,6 +514,17 @@ data_t kimLowerBound(const TimeSeries& a, const TimeSeries& b, data_t dropout)
   return lb;
 }
 
+data_t endpointLowerBound(const TimeSeries& a, const TimeSeries& b)
+{
+  int al = a.getLength();
+  int bl = b.getLength();
+  data_t lb = _euc(a[0], b[0]);
+  if (al > 1 || bl > 1) {
+    lb += _euc(a[al - 1], b[bl - 1]);
+  }
+  return _euc_norm_dtw(lb, a, b);
+}
+
 data_t keoghLowerBound(const TimeSeries& a, const TimeSeries& b, data_t dropout)
 {
 
@@ -227,21 +559,165 @@ data_t crossKeoghLowerBound(const TimeSeries& a, const TimeSeries& b, data_t dro
   }
 }
 
-data_t cascadeDistance(const TimeSeries& a, const TimeSeries& b, data_t dropout)
+data_t envelopeLowerBound(const TimeSeries& a, const TimeSeries& lower, const TimeSeries& upper)
+{
+  int len = min(a.getLength(), lower.getLength());
+  int warpingBand = calculateWarpingBandSize(max(a.getLength(), lower.getLength()));
+  const data_t* aLower = a.getKeoghLower(warpingBand);
+  const data_t* aUpper = a.getKeoghUpper(warpingBand);
+  // The Keogh envelope of every time series of the set lies within these
+  const data_t* lowerLower = lower.getKeoghLower(warpingBand);
+  const data_t* upperUpper = upper.getKeoghUpper(warpingBand);
+  data_t lb = 0, crossLb = 0;
+
+  for (int i = 0; i < len; i++)
+  {
+    if (lower[i] > aUpper[i]) {
+      lb += _euc(lower[i], aUpper[i]);
+    }
+    else if (upper[i] < aLower[i]) {
+      lb += _euc(upper[i], aLower[i]);
+    }
+
+    if (a[i] > upperUpper[i]) {
+      crossLb += _euc(a[i], upperUpper[i]);
+    }
+    else if (a[i] < lowerLower[i]) {
+      crossLb += _euc(a[i], lowerLower[i]);
+    }
+  }
+  return _euc_norm_dtw(max(lb, crossLb), a, lower);
+}
+
+data_t improvedLowerBound(const TimeSeries& a, const TimeSeries& b, data_t dropout)
+{
+  int m = a.getLength();
+  int n = b.getLength();
+  int len = min(m, n);
+  int warpingBand = calculateWarpingBandSize(max(m, n));
+  const data_t* aLower = a.getKeoghLower(warpingBand);
+  const data_t* aUpper = a.getKeoghUpper(warpingBand);
+  data_t idropout = _euc_inorm_dtw(dropout, max(m, n));
+  data_t lb = 0;
+
+  // The projection of b and its envelope. Values of b beyond the envelope
+  // of a are left as they are
+  vector<data_t> buffer(3 * n);
+  data_t* projection = buffer.data();
+  data_t* lower = projection + n;
+  data_t* upper = lower + n;
+  for (int j = 0; j < n; j++)
+  {
+    projection[j] = b[j];
+    if (j >= len) {
+      continue;
+    }
+    if (b[j] > aUpper[j]) {
+      lb += _euc(b[j], aUpper[j]);
+      projection[j] = aUpper[j];
+    }
+    else if (b[j] < aLower[j]) {
+      lb += _euc(b[j], aLower[j]);
+      projection[j] = aLower[j];
+    }
+  }
+  if (lb >= idropout) {
+    return _euc_norm_dtw(lb, max(m, n));
+  }
+
+  lower_upper_lemire(projection, n, min(warpingBand, n - 1), lower, upper);
+  for (int i = 0; i < len && lb < idropout; i++)
+  {
+    if (a[i] > upper[i]) {
+      lb += _euc(a[i], upper[i]);
+    }
+    else if (a[i] < lower[i]) {
+      lb += _euc(a[i], lower[i]);
+    }
+  }
+  return _euc_norm_dtw(lb, max(m, n));
+}
+
+std::atomic<uint64_t> cascadeCandidates(0), cascadeKeoghPruned(0), cascadeImprovedPruned(0);
+
+cascade_stats_t getCascadeStats()
+{
+  cascade_stats_t stats;
+  stats.candidates = cascadeCandidates;
+  stats.keoghPruned = cascadeKeoghPruned;
+  stats.improvedPruned = cascadeImprovedPruned;
+  stats.warped = stats.candidates - stats.keoghPruned - stats.improvedPruned;
+  return stats;
+}
+
+void resetCascadeStats()
+{
+  cascadeCandidates = 0;
+  cascadeKeoghPruned = 0;
+  cascadeImprovedPruned = 0;
+}
+
+/**
+ *  @brief returns true if a lower bound of cascadeDistance is above dropout
+ */
+bool _cascade_prune(const TimeSeries& a, const TimeSeries& b, data_t dropout)
 {
+  cascadeCandidates.fetch_add(1, std::memory_order_relaxed);
   // Temporarily disable this because the code seems to be problematic
   // data_t lb = kimLowerBound(a, b, dropout);
   // if (lb > dropout) {
-  //   return INF;
+  //   return true;
   // }
-  data_t lb = crossKeoghLowerBound(a, b, dropout);
-  if (lb > dropout) {
+  if (crossKeoghLowerBound(a, b, dropout) > dropout) {
+    cascadeKeoghPruned.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  // Nothing is above an infinite dropout
+  if (dropout < INF && improvedLowerBound(a, b, dropout) > dropout) {
+    cascadeImprovedPruned.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+data_t cascadeDistance(const TimeSeries& a, const TimeSeries& b, data_t dropout)
+{
+  if (_cascade_prune(a, b, dropout)) {
     return INF;
   }
   data_t d = warpedDistance(a, b, dropout);
   return d;
 }
 
+vector<data_t> batchDistance(const dist_t distance, const TimeSeries& a, const vector<const TimeSeries*>& b,
+                             data_t dropout)
+{
+  vector<data_t> result(b.size());
+  for (unsigned int k = 0; k < b.size(); k++) {
+    result[k] = distance(a, *b[k], dropout);
+  }
+  return result;
+}
+
+vector<data_t> cascadeDistanceBatch(const TimeSeries& a, const vector<const TimeSeries*>& b, data_t dropout)
+{
+  vector<data_t> result(b.size(), INF);
+  vector<const TimeSeries*> survivors;
+  vector<int> positions;
+  for (unsigned int k = 0; k < b.size(); k++)
+  {
+    if (!_cascade_prune(a, *b[k], dropout)) {
+      survivors.push_back(b[k]);
+      positions.push_back(k);
+    }
+  }
+  vector<data_t> distances = warpedDistanceBatch(a, survivors, dropout);
+  for (unsigned int k = 0; k < positions.size(); k++) {
+    result[positions[k]] = distances[k];
+  }
+  return result;
+}
+
 data_t pairwiseDistance(const TimeSeries& x_1, const TimeSeries& x_2, data_t dropout)
 {
   if (x_1.getLength() != x_2.getLength())
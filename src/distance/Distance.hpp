@@ -1,6 +1,8 @@
 #ifndef GENERAL_DISTANCE_H
 #define GENERAL_DISTANCE_H
 
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <algorithm>
 #include <iostream>
@@ -18,6 +20,11 @@ namespace onex {
 
 typedef data_t (*dist_t)(const TimeSeries&, const TimeSeries&, data_t);
 
+/**
+ *  A distance between a time series and several others, see batchDistance
+ */
+typedef std::function<vector<data_t>(const TimeSeries&, const vector<const TimeSeries*>&, data_t)> batch_dist_t;
+
 int calculateWarpingBandSize(int length);
 void setWarpingBandRatio(double ratio);
   
@@ -38,6 +45,10 @@ const vector<string>& getAllDistanceName();
 /**
  *  @brief returns the warped distance between two sets of data
  *
+ *  On CPUs with AVX2, the cost matrix is computed by anti-diagonals, whose
+ *  cells are independent. Otherwise, and for very short data, it is
+ *  computed row by row. Both give the same result.
+ *
  *  @param metric the distance metric to use
  *  @param a one of the two arrays of data
  *  @param b the other of the two arrays of data
@@ -45,6 +56,48 @@ const vector<string>& getAllDistanceName();
  */
 data_t warpedDistance(const TimeSeries& a, const TimeSeries& b, data_t dropout);
 
+/**
+ *  @brief returns the warped distances between a and the prefixes of b of
+ *         several lengths
+ *
+ *  While the warping band stays the same, the cost matrix of a prefix is a
+ *  prefix of the matrix of a longer one. So the matrix is extended one
+ *  column at a time, once for every band size, and the distance of a prefix
+ *  is read off when its last column is done.
+ *
+ *  @param a one of the two arrays of data
+ *  @param b the other array, at least as long as the longest prefix
+ *  @param lengths the lengths of the prefixes of b
+ *  @param dropout a distance that is not less than this may be INF
+ *  @return the distance to each prefix, in the order of lengths. Each one is
+ *          the one warpedDistance returns
+ */
+vector<data_t> warpedDistancePrefixes(const TimeSeries& a, const TimeSeries& b,
+                                      const vector<int>& lengths, data_t dropout);
+
+/**
+ *  Number of candidates that warpedDistanceBatch computes together
+ */
+#define WARPED_DISTANCE_LANES 8
+
+/**
+ *  @brief returns the warped distances between a and several time series
+ *         of the same length
+ *
+ *  The recurrence within a row of a cost matrix depends on the previous
+ *  cell, so a single warped distance does not vectorize. Here each
+ *  candidate of a batch of WARPED_DISTANCE_LANES is given its own lane,
+ *  and the same cell of every lane is computed at once. A lane is abandoned
+ *  like warpedDistance abandons, and the batch stops when all lanes are.
+ *
+ *  @param a one of the two arrays of data
+ *  @param b the other arrays, all of the same length
+ *  @param dropout a distance that is not less than this may be INF
+ *  @return the distance to each time series of b, in the same order. Each
+ *          one is the one warpedDistance returns
+ */
+vector<data_t> warpedDistanceBatch(const TimeSeries& a, const vector<const TimeSeries*>& b, data_t dropout);
+
 /**
  * Calculates pairwise distance between two time series. This function is enabled if the given
  * distance metric class DM has the 'hasInverseNorm' function.
@@ -56,13 +109,89 @@ data_t pairwiseDistance(const TimeSeries& x_1, const TimeSeries& x_2, data_t dro
  */
 data_t keoghLowerBound(const TimeSeries& a, const TimeSeries& b, data_t dropout);
 data_t kimLowerBound(const TimeSeries& a, const TimeSeries& b, data_t dropout);
+
+/**
+ *  @brief lower bound of the warped distance from the first and the last
+ *         points, which every warping path matches
+ *
+ *  It is normalized like warpedDistance and takes constant time.
+ */
+data_t endpointLowerBound(const TimeSeries& a, const TimeSeries& b);
 data_t crossKeoghLowerBound(const TimeSeries& a, const TimeSeries& b, data_t dropout);
 
 /**
- * ...
+ *  @brief lower bound of the warped distance between a and every time series
+ *         whose values lie pointwise between lower and upper
+ *
+ *  This is crossKeoghLowerBound with b replaced by an envelope, so it bounds
+ *  a whole set of time series of the same length at once.
+ *
+ *  @param a a time series
+ *  @param lower pointwise minimum of the set
+ *  @param upper pointwise maximum of the set
+ */
+data_t envelopeLowerBound(const TimeSeries& a, const TimeSeries& lower, const TimeSeries& upper);
+
+/**
+ *  @brief Lemire's LB_Improved lower bound of the warped distance between a
+ *         and b
+ *
+ *  b is projected onto the envelope of a, which costs what keoghLowerBound
+ *  of a and b costs, and a is compared with the envelope of the projection
+ *  for a second Keogh pass. The bound is never lower than keoghLowerBound.
+ *
+ *  @param a the time series whose envelope is used
+ *  @param b the other time series
+ *  @param dropout the computation stops once the bound is above this
+ */
+data_t improvedLowerBound(const TimeSeries& a, const TimeSeries& b, data_t dropout);
+
+/**
+ *  @brief counts of the pairs that each stage of cascadeDistance stopped,
+ *         since the program started or resetCascadeStats was called
+ */
+struct cascade_stats_t
+{
+  uint64_t candidates;      // pairs given to cascadeDistance
+  uint64_t keoghPruned;     // pairs pruned by crossKeoghLowerBound
+  uint64_t improvedPruned;  // pairs pruned by improvedLowerBound
+  uint64_t warped;          // pairs whose warped distance was computed
+};
+
+cascade_stats_t getCascadeStats();
+void resetCascadeStats();
+
+/**
+ *  @brief returns the warped distance between a and b, unless one of the
+ *         lower bounds shows it is above dropout
+ *
+ *  crossKeoghLowerBound is tried first, then improvedLowerBound, which is
+ *  tighter but computes an envelope. Pairs are counted in cascade_stats_t.
  */
 data_t cascadeDistance(const TimeSeries& a, const TimeSeries& b, data_t dropout);
 
+/**
+ *  @brief returns the distances between a and several time series of the
+ *         same length, one at a time
+ *
+ *  @param distance the distance
+ *  @param a one of the two arrays of data
+ *  @param b the other arrays
+ *  @param dropout a distance that is not less than this may be INF
+ *  @return the distance to each time series of b, in the same order
+ */
+vector<data_t> batchDistance(const dist_t distance, const TimeSeries& a, const vector<const TimeSeries*>& b,
+                             data_t dropout);
+
+/**
+ *  @brief returns cascadeDistance between a and several time series of the
+ *         same length
+ *
+ *  The lower bounds of cascadeDistance prune what they can, and the warped
+ *  distances of the rest are computed by warpedDistanceBatch.
+ */
+vector<data_t> cascadeDistanceBatch(const TimeSeries& a, const vector<const TimeSeries*>& b, data_t dropout);
+
 } // namespace onex
 
 #endif //GENERAL_DISTANCE_H
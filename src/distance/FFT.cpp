@@ -0,0 +1,99 @@
+#include "distance/FFT.hpp"
+#include "Exception.hpp"
+
+#include <cmath>
+#include <utility>
+
+using std::vector;
+
+namespace onex {
+
+FFT::FFT(int size) : size(size)
+{
+  if (size <= 0 || (size & (size - 1)) != 0)
+  {
+    throw OnexException("Size of FFT must be a power of two");
+  }
+
+  int logSize = 0;
+  while ((1 << logSize) < size) {
+    logSize++;
+  }
+
+  this->reversed.resize(size);
+  for (int i = 0; i < size; i++)
+  {
+    int r = 0;
+    for (int b = 0; b < logSize; b++)
+    {
+      if (i & (1 << b)) {
+        r |= 1 << (logSize - 1 - b);
+      }
+    }
+    this->reversed[i] = r;
+  }
+
+  // roots[k] = exp(-2*pi*i*k/size) for k < size/2. Computing each root
+  // directly instead of by repeated multiplication keeps the error small for
+  // large transforms
+  this->roots.resize(std::max(size / 2, 1));
+  for (int k = 0; k < size / 2; k++)
+  {
+    double angle = -2 * M_PI * k / size;
+    this->roots[k] = complex_t(cos(angle), sin(angle));
+  }
+}
+
+void FFT::transform(vector<complex_t>& a, bool inverse) const
+{
+  if ((int)a.size() != this->size)
+  {
+    throw OnexException("Sequence size does not match size of FFT");
+  }
+
+  for (int i = 0; i < this->size; i++)
+  {
+    if (i < this->reversed[i]) {
+      std::swap(a[i], a[this->reversed[i]]);
+    }
+  }
+
+  for (int len = 2; len <= this->size; len <<= 1)
+  {
+    int half = len >> 1;
+    int step = this->size / len;
+    for (int i = 0; i < this->size; i += len)
+    {
+      for (int j = 0; j < half; j++)
+      {
+        complex_t w = this->roots[j * step];
+        if (inverse) {
+          w = std::conj(w);
+        }
+        complex_t u = a[i + j];
+        complex_t v = a[i + j + half] * w;
+        a[i + j] = u + v;
+        a[i + j + half] = u - v;
+      }
+    }
+  }
+
+  if (inverse)
+  {
+    double scale = 1.0 / this->size;
+    for (int i = 0; i < this->size; i++) {
+      a[i] *= scale;
+    }
+  }
+}
+
+int FFT::nextPowerOfTwo(int n)
+{
+  int p = 1;
+  while (p < n) {
+    p <<= 1;
+  }
+  return p;
+}
+
+} // namespace onex
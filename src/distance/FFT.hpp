@@ -0,0 +1,58 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+#include <vector>
+
+namespace onex {
+
+typedef std::complex<double> complex_t;
+
+/**
+ *  @brief an iterative radix-2 fast Fourier transform of a fixed size
+ *
+ *  The bit-reversal permutation and the roots of unity are computed once in
+ *  the constructor so that many transforms of the same size can be done
+ *  without recomputing them.
+ */
+class FFT
+{
+public:
+
+  /**
+   *  @brief constructor for FFT
+   *
+   *  @param size number of points of the transform. Must be a power of two
+   *
+   *  @throw OnexException if size is not a positive power of two
+   */
+  FFT(int size);
+
+  /**
+   *  @brief gets the number of points of the transform
+   */
+  int getSize() const { return this->size; }
+
+  /**
+   *  @brief transforms a sequence in place
+   *
+   *  @param a the sequence to transform. Its size must be equal to getSize()
+   *  @param inverse if true, the inverse transform (including the 1/n
+   *         scaling) is computed
+   */
+  void transform(std::vector<complex_t>& a, bool inverse) const;
+
+  /**
+   *  @return the smallest power of two that is larger than or equal to n
+   */
+  static int nextPowerOfTwo(int n);
+
+private:
+  int size;
+  std::vector<int> reversed;
+  std::vector<complex_t> roots;
+};
+
+} // namespace onex
+
+#endif // FFT_H
@@ -0,0 +1,95 @@
+#include "distance/MASS.hpp"
+#include "Exception.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+// Relative error of an FFT based convolution is a small multiple of the
+// machine epsilon times log2 of its size. This factor leaves plenty of room
+// for transforms of any size that fits in memory.
+#define MASS_ERROR_FACTOR 1e-10
+
+using std::vector;
+
+namespace onex {
+
+MASS::MASS(const TimeSeries& query, int seriesLength)
+  : queryLength(query.getLength()),
+    seriesLength(seriesLength),
+    querySquareSum(0),
+    fft(FFT::nextPowerOfTwo(seriesLength + query.getLength()))
+{
+  if (this->queryLength <= 0 || this->queryLength > seriesLength)
+  {
+    throw OnexException("Query must not be longer than the time series");
+  }
+
+  // The reversed query turns the convolution into sliding dot products
+  this->queryTransform.assign(this->fft.getSize(), complex_t(0, 0));
+  for (int i = 0; i < this->queryLength; i++)
+  {
+    double q = query[i];
+    this->queryTransform[this->queryLength - 1 - i] = complex_t(q, 0);
+    this->querySquareSum += q * q;
+  }
+  this->fft.transform(this->queryTransform, false);
+}
+
+void MASS::distanceProfile(const data_t* a, const data_t* b,
+                           vector<data_t>& profileA, vector<data_t>& profileB) const
+{
+  vector<complex_t> products(this->fft.getSize(), complex_t(0, 0));
+  for (int i = 0; i < this->seriesLength; i++) {
+    products[i] = complex_t(a[i], b ? b[i] : 0);
+  }
+
+  this->fft.transform(products, false);
+  for (int i = 0; i < this->fft.getSize(); i++) {
+    products[i] *= this->queryTransform[i];
+  }
+  this->fft.transform(products, true);
+
+  this->fillProfile(products, false, a, profileA);
+  if (b) {
+    this->fillProfile(products, true, b, profileB);
+  }
+}
+
+void MASS::distanceProfile(const data_t* a, vector<data_t>& profile) const
+{
+  vector<data_t> unused;
+  this->distanceProfile(a, nullptr, profile, unused);
+}
+
+void MASS::fillProfile(const vector<complex_t>& products, bool imaginary,
+                       const data_t* series, vector<data_t>& profile) const
+{
+  int m = this->queryLength;
+  int profileLength = this->getProfileLength();
+  profile.resize(profileLength);
+
+  double totalSquareSum = 0;
+  for (int i = 0; i < this->seriesLength; i++) {
+    totalSquareSum += (double)series[i] * series[i];
+  }
+  double error = MASS_ERROR_FACTOR *
+    (sqrt(totalSquareSum * this->querySquareSum) + totalSquareSum + this->querySquareSum);
+
+  // Rolling sum of squares of the current window
+  double windowSquareSum = 0;
+  for (int i = 0; i < m - 1; i++) {
+    windowSquareSum += (double)series[i] * series[i];
+  }
+
+  for (int i = 0; i < profileLength; i++)
+  {
+    windowSquareSum += (double)series[i + m - 1] * series[i + m - 1];
+    const complex_t& p = products[i + m - 1];
+    double dot = imaginary ? p.imag() : p.real();
+    double squared = this->querySquareSum + windowSquareSum - 2 * dot - error;
+    profile[i] = squared > 0 ? sqrt(squared / m) : 0;
+    windowSquareSum -= (double)series[i] * series[i];
+  }
+}
+
+} // namespace onex
@@ -0,0 +1,87 @@
+#ifndef MASS_H
+#define MASS_H
+
+#include <vector>
+
+#include "TimeSeries.hpp"
+#include "distance/FFT.hpp"
+
+namespace onex {
+
+/**
+ *  @brief computes distance profiles of a query using MASS (Mueen's Algorithm
+ *         for Similarity Search)
+ *
+ *  A distance profile of a query Q of length m against a time series T of
+ *  length n is the vector of Euclidean distances between Q and every
+ *  sub-sequence T[i, i + m) for i = 0..n-m. The distance is normalized the
+ *  same way as pairwiseDistance, i.e. sqrt(sum((Q[k] - T[i + k])^2) / m).
+ *
+ *  The sliding dot products are computed with an FFT so each profile costs
+ *  O(n log n) instead of O(n * m). Since the query is real, two time series
+ *  are packed into the real and imaginary parts of one transform and their
+ *  profiles are computed together.
+ *
+ *  Values of a profile are accurate up to the floating-point error of the
+ *  FFT. To make them usable for pruning, each value is rounded down by a
+ *  bound of that error, so a profile value never exceeds the true distance.
+ *  Callers that need exact distances should verify the candidates they keep
+ *  with pairwiseDistance.
+ */
+class MASS
+{
+public:
+
+  /**
+   *  @brief constructor for MASS
+   *
+   *  The transform of the query is computed here and reused for every
+   *  profile.
+   *
+   *  @param query the query
+   *  @param seriesLength length of the time series the query is compared to
+   *
+   *  @throw OnexException if the query is longer than the time series
+   */
+  MASS(const TimeSeries& query, int seriesLength);
+
+  /**
+   *  @brief gets the number of values in a distance profile
+   */
+  int getProfileLength() const { return this->seriesLength - this->queryLength + 1; }
+
+  /**
+   *  @brief computes the distance profiles of the query against two time series
+   *
+   *  @param a values of the first time series
+   *  @param b values of the second time series. If this is nullptr, only the
+   *         profile of a is computed
+   *  @param profileA (output) distance profile against a
+   *  @param profileB (output) distance profile against b
+   */
+  void distanceProfile(const data_t* a, const data_t* b,
+                       std::vector<data_t>& profileA,
+                       std::vector<data_t>& profileB) const;
+
+  /**
+   *  @brief computes the distance profile of the query against a time series
+   *
+   *  @param a values of the time series
+   *  @param profile (output) distance profile against a
+   */
+  void distanceProfile(const data_t* a, std::vector<data_t>& profile) const;
+
+private:
+  void fillProfile(const std::vector<complex_t>& products, bool imaginary,
+                   const data_t* series, std::vector<data_t>& profile) const;
+
+  int queryLength;
+  int seriesLength;
+  double querySquareSum;
+  FFT fft;
+  std::vector<complex_t> queryTransform;
+};
+
+} // namespace onex
+
+#endif // MASS_H
@@ -6,6 +6,7 @@
 #include "distance/Distance.hpp"
 #include "Exception.hpp"
 #include "Group.hpp"
+#include "Deadline.hpp"
 
 #define TOLERANCE 1e-9
 
@@ -61,4 +62,126 @@ BOOST_AUTO_TEST_CASE( traverse_order )
   vector<int> order = generateTraverseOrder(3, 7);
   vector<int> expected = { 3, 2, 4, 5 };
   BOOST_CHECK_EQUAL_COLLECTIONS(order.begin(), order.end(), expected.begin(), expected.end());
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE( approximate_match )
+{
+  setWarpingBandRatio(0.1);
+  TimeSeriesSet tsSet;
+  tsSet.loadData("datasets/test/test_10_20_space.txt", 0, 0, " ");
+  GlobalGroupSpace gSet(tsSet);
+  gSet.group("euclidean", 0.2);
+
+  TimeSeries query(12);
+  for (int k = 0; k < 12; k++) {
+    query[k] = (tsSet.getTimeSeries(2)[k + 3] + tsSet.getTimeSeries(5)[k]) / 2;
+  }
+
+  // Without limits, the search is the full one
+  candidate_time_series_t exact = gSet.getBestMatch(query);
+  match_result_t result = gSet.getBestMatch(query, match_options_t());
+  BOOST_CHECK_EQUAL( result.match.dist, exact.dist );
+  BOOST_CHECK( result.complete );
+  BOOST_CHECK( result.lengthsVisited >= 1 && result.lengthsVisited <= result.lengthCount );
+  BOOST_CHECK( result.groupsVisited > 0 );
+
+  // Budgets stop the search early
+  match_options_t options;
+  options.maxGroups = 1;
+  result = gSet.getBestMatch(query, options);
+  BOOST_CHECK_EQUAL( result.groupsVisited, 1 );
+  BOOST_CHECK_EQUAL( result.lengthsVisited, 1 );
+  BOOST_CHECK( !result.complete );
+  BOOST_CHECK_EQUAL( result.match.data.getLength(), 12 );
+  BOOST_CHECK_EQUAL( warpedDistance(query, result.match.data, INF), result.match.dist );
+
+  options = match_options_t();
+  options.maxLengths = 1;
+  result = gSet.getBestMatch(query, options);
+  BOOST_CHECK_EQUAL( result.lengthsVisited, 1 );
+  BOOST_CHECK_EQUAL( result.match.data.getLength(), 12 );
+
+  // Any centroid is good enough with a large tolerance
+  options = match_options_t();
+  options.epsilon = INF;
+  result = gSet.getBestMatch(query, options);
+  BOOST_CHECK_EQUAL( result.groupsVisited, 1 );
+  BOOST_CHECK( !result.complete );
+
+  // Stopping at a distance of 0 does not lose anything
+  options.epsilon = 1e-3;
+  result = gSet.getBestMatch(tsSet.getTimeSeries(4, 2, 9), options);
+  BOOST_CHECK_EQUAL( result.match.dist, 0 );
+  BOOST_CHECK( result.complete );
+}
+
+BOOST_AUTO_TEST_CASE( deadline_match )
+{
+  setWarpingBandRatio(0.1);
+  TimeSeriesSet tsSet;
+  tsSet.loadData("datasets/test/test_10_20_space.txt", 0, 0, " ");
+  GlobalGroupSpace gSet(tsSet);
+  gSet.group("euclidean", 0.1);
+
+  TimeSeries query(10);
+  for (int k = 0; k < 10; k++) {
+    query[k] = (tsSet.getTimeSeries(1)[k + 5] + tsSet.getTimeSeries(8)[k + 2]) / 2;
+  }
+  candidate_time_series_t exact = gSet.getBestMatch(query);
+
+  // A generous budget does not change the result
+  match_options_t options;
+  options.timeBudget = 60;
+  match_result_t result = gSet.getBestMatch(query, options);
+  BOOST_CHECK( result.complete );
+  BOOST_CHECK_EQUAL( result.match.dist, exact.dist );
+
+  // An expired budget still returns a match, flagged as incomplete
+  options.timeBudget = 1e-12;
+  result = gSet.getBestMatch(query, options);
+  BOOST_CHECK( !result.complete );
+  BOOST_CHECK( result.groupsVisited >= 1 );
+  BOOST_CHECK_EQUAL( result.match.data.getLength(), 10 );
+  BOOST_CHECK_EQUAL( warpedDistance(query, result.match.data, INF), result.match.dist );
+}
+
+BOOST_AUTO_TEST_CASE( all_lengths_match, *boost::unit_test::tolerance(1e-9) )
+{
+  setWarpingBandRatio(0.2);
+  TimeSeriesSet tsSet;
+  tsSet.loadData("datasets/test/test_10_20_space.txt", 0, 0, " ");
+  GlobalGroupSpace gSet(tsSet);
+  gSet.group("euclidean", 0.2);
+
+  TimeSeries query(11);
+  for (int k = 0; k < 11; k++) {
+    query[k] = (tsSet.getTimeSeries(3)[k + 4] + tsSet.getTimeSeries(7)[k + 1]) / 2;
+  }
+  candidate_time_series_t exact = gSet.getBestMatch(query);
+
+  // The length of the best group is one of the lengths compared
+  match_options_t options;
+  options.allLengths = true;
+  match_result_t result = gSet.getBestMatch(query, options);
+  BOOST_CHECK( result.complete );
+  BOOST_TEST( result.match.dist <= exact.dist );
+
+  const TimeSeries& match = result.match.data;
+  BOOST_CHECK( match.getEnd() <= tsSet.getItemLength() );
+  BOOST_TEST( warpedDistance(query, match, INF) == result.match.dist );
+  setWarpingBandRatio(0.1);
+}
+
+BOOST_AUTO_TEST_CASE( deadline )
+{
+  Deadline never;
+  for (int i = 0; i < 100; i++) {
+    BOOST_CHECK( !never.expired() );
+  }
+  BOOST_CHECK( !never.isReached() );
+
+  Deadline past(1e-12);
+  while (!past.expired()) {}
+  BOOST_CHECK( past.isReached() );
+  BOOST_CHECK( past.expired() );
+}
@@ -0,0 +1,47 @@
+#define BOOST_TEST_MODULE "Test group file encoding"
+
+#include <cstdint>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+
+#include "GroupFile.hpp"
+#include "Exception.hpp"
+
+using namespace onex;
+
+BOOST_AUTO_TEST_CASE( encode_decode_members )
+{
+  // Groups of different sizes so that blocks start in the middle of groups
+  std::vector<uint64_t> memberOffsets(1, 0);
+  std::vector<uint32_t> members;
+  uint32_t value = 7;
+  int sizes[] = { 1, 300, 5, 700, 1, 1 };
+  for (int size : sizes)
+  {
+    for (int i = 0; i < size; i++)
+    {
+      members.push_back(value);
+      value += 1 + (i * 37) % 1000;
+    }
+    memberOffsets.push_back(members.size());
+    value = value / 3;
+  }
+  members.back() = UINT32_MAX;
+
+  std::vector<uint64_t> blockOffsets;
+  std::vector<uint8_t> bytes;
+  encodeMembers(memberOffsets, members, blockOffsets, bytes);
+  BOOST_CHECK_EQUAL( blockOffsets.size(), getMemberBlockCount(members.size()) + 1 );
+  BOOST_CHECK( bytes.size() < members.size() * sizeof(uint32_t) );
+
+  std::vector<uint32_t> decoded(members.size());
+  decodeMembers(memberOffsets.data(), memberOffsets.size() - 1, blockOffsets.data(),
+                bytes.data(), decoded.data(), decoded.size());
+  BOOST_CHECK( decoded == members );
+
+  // A varint that runs past the end of its block
+  bytes[blockOffsets[1] - 1] |= 0x80;
+  BOOST_CHECK_THROW( decodeMembers(memberOffsets.data(), memberOffsets.size() - 1,
+                                   blockOffsets.data(), bytes.data(),
+                                   decoded.data(), decoded.size()), OnexException );
+}
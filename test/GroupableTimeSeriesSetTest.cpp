@@ -1,5 +1,8 @@
 #define BOOST_TEST_MODULE "Test GroupableTimeSeriesSet class"
 
+#include <cstdio>
+#include <fstream>
+#include <iterator>
 #include <vector>
 #include <boost/test/unit_test.hpp>
 
@@ -50,4 +53,240 @@ BOOST_AUTO_TEST_CASE( basic_get_best_match )
   tsSet.groupAllLengths("euclidean", 0.5);
   candidate_time_series_t best = tsSet.getBestMatch(tsSet.getTimeSeries(0));
   BOOST_TEST( best.dist == 0.0 );
-}
\ No newline at end of file
+
+  tsSet.groupAllLengths("euclidean", 0.5, 2);
+  best = tsSet.getBestMatch(tsSet.getTimeSeries(0));
+  BOOST_TEST( best.dist == 0.0 );
+
+  // By Euclidean distance, the match is exact and has the query's length
+  TimeSeries query = tsSet.getTimeSeries(1, 2, 8);
+  best = tsSet.getBestMatchEuclidean(query);
+  BOOST_CHECK_EQUAL( best.data.getLength(), query.getLength() );
+  BOOST_CHECK_CLOSE( best.dist + 1, tsSet.getBestMatchBruteForce(query).dist + 1, 1e-4 );
+  BOOST_CHECK_THROW( tsSet.getBestMatchEuclidean(tsSet.getTimeSeries(1, 3, 4)), OnexException );
+}
+
+std::string readFile(const std::string& path)
+{
+  std::ifstream f(path, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+
+BOOST_AUTO_TEST_CASE( save_load_groups )
+{
+  std::string textPath = "test_groups_v1.tmp";
+  std::string binaryPath = "test_groups_v2.tmp";
+  std::string binaryCopyPath = "test_groups_v2_copy.tmp";
+
+  GroupableTimeSeriesSet tsSet;
+  tsSet.loadData(data.test_10_20_space, 0, 0, " ");
+  int groupCnt = tsSet.groupAllLengths("euclidean", 0.5);
+  tsSet.saveGroups(textPath, false, GROUP_FILE_TEXT_VERSION);
+  tsSet.saveGroups(binaryPath, false);
+  BOOST_CHECK_THROW( tsSet.saveGroups(binaryPath, false, 3), OnexException );
+
+  GroupableTimeSeriesSet fromText;
+  GroupableTimeSeriesSet fromBinary;
+  fromText.loadData(data.test_10_20_space, 0, 0, " ");
+  fromBinary.loadData(data.test_10_20_space, 0, 0, " ");
+  BOOST_CHECK_EQUAL( fromText.loadGroups(textPath), groupCnt );
+  BOOST_CHECK_EQUAL( fromBinary.loadGroups(binaryPath), groupCnt );
+
+  // Members are saved in a canonical order, so saving again gives the same file,
+  // even after Euclidean queries sorted them by distance to their centroid
+  fromBinary.getBestMatchEuclidean(tsSet.getTimeSeries(0, 0, 5));
+  fromBinary.saveGroups(binaryCopyPath, false);
+  BOOST_CHECK( readFile(binaryPath) == readFile(binaryCopyPath) );
+
+  for (int i = 0; i < tsSet.getItemCount(); i++)
+  {
+    TimeSeries query = tsSet.getTimeSeries(i, 3, 12);
+    candidate_time_series_t expected = tsSet.getBestMatch(query);
+    candidate_time_series_t text = fromText.getBestMatch(query);
+    candidate_time_series_t binary = fromBinary.getBestMatch(query);
+    BOOST_CHECK_CLOSE( text.dist, expected.dist, 1e-6 );
+    BOOST_CHECK_EQUAL( binary.dist, expected.dist );
+    BOOST_CHECK_EQUAL( binary.data.getIndex(), expected.data.getIndex() );
+    BOOST_CHECK_EQUAL( binary.data.getStart(), expected.data.getStart() );
+  }
+
+  // Centroids loaded from text are not references, so their values are saved
+  fromText.saveGroups(binaryCopyPath, false);
+  BOOST_CHECK( readFile(binaryCopyPath).size() > readFile(binaryPath).size() );
+  BOOST_CHECK_EQUAL( fromText.loadGroups(binaryCopyPath), groupCnt );
+  TimeSeries query = tsSet.getTimeSeries(1, 2, 9);
+  BOOST_CHECK_CLOSE( fromText.getBestMatch(query).dist, tsSet.getBestMatch(query).dist, 1e-6 );
+
+  // Groups must come from a dataset with the same dimensions
+  GroupableTimeSeriesSet other;
+  other.loadData(data.test_3_10_space, 0, 0, " ");
+  BOOST_CHECK_THROW( other.loadGroups(binaryPath), OnexException );
+  BOOST_CHECK( !other.isGrouped() );
+
+  // A truncated file is rejected
+  std::string bytes = readFile(binaryPath);
+  std::ofstream(binaryCopyPath, std::ios::binary) << bytes.substr(0, bytes.size() / 2);
+  BOOST_CHECK_THROW( fromBinary.loadGroups(binaryCopyPath), OnexException );
+  BOOST_CHECK( !fromBinary.isGrouped() );
+
+  std::remove(textPath.c_str());
+  std::remove(binaryPath.c_str());
+  std::remove(binaryCopyPath.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( save_load_mean_groups )
+{
+  std::string path = "test_groups_mean.tmp";
+
+  GroupableTimeSeriesSet tsSet;
+  tsSet.loadData(data.test_10_20_space, 0, 0, " ");
+  int firstCnt = tsSet.groupAllLengths("euclidean", 0.5);
+  int groupCnt = tsSet.groupAllLengths("euclidean", 0.5, 1, GROUP_ORDER_START, true);
+  BOOST_CHECK( groupCnt <= firstCnt );
+  tsSet.saveGroups(path, false);
+
+  // The centroids and radii are read back as they were
+  GroupableTimeSeriesSet loaded;
+  loaded.loadData(data.test_10_20_space, 0, 0, " ");
+  BOOST_CHECK_EQUAL( loaded.loadGroups(path), groupCnt );
+  for (int i = 0; i < tsSet.getItemCount(); i++)
+  {
+    TimeSeries query = tsSet.getTimeSeries(i, 2, 11);
+    BOOST_CHECK_EQUAL( loaded.getBestMatch(query).dist, tsSet.getBestMatch(query).dist );
+  }
+
+  std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( refine_loaded_groups )
+{
+  std::string path = "test_groups_refine.tmp";
+
+  GroupableTimeSeriesSet tsSet;
+  tsSet.loadData(data.test_10_20_space, 0, 0, " ");
+  BOOST_CHECK_THROW( tsSet.refineGroups(3, 2), OnexException );
+  int groupCnt = tsSet.groupAllLengths("euclidean", 0.5);
+  tsSet.saveGroups(path, false);
+
+  // Every length is read from the file before it is refined
+  GroupableTimeSeriesSet lazy;
+  lazy.loadData(data.test_10_20_space, 0, 0, " ");
+  lazy.loadGroups(path);
+  lazy.setGroupMemoryLimit(1);
+  refine_result_t result = lazy.refineGroups(3, 2);
+  BOOST_CHECK_EQUAL( result.groupCountBefore, groupCnt );
+  BOOST_CHECK( result.groupCount <= groupCnt );
+  BOOST_CHECK_EQUAL( result.memoryUsage, lazy.getMemoryUsage().groups );
+  BOOST_CHECK_EQUAL( lazy.getLoadedLengthCount(), tsSet.getItemLength() - 1 );
+
+  // The refined groups can replace the file they were read from
+  lazy.saveGroups(path, false);
+  GroupableTimeSeriesSet reloaded;
+  reloaded.loadData(data.test_10_20_space, 0, 0, " ");
+  BOOST_CHECK_EQUAL( reloaded.loadGroups(path), result.groupCount );
+  TimeSeries query = tsSet.getTimeSeries(3, 2, 12);
+  BOOST_CHECK_EQUAL( reloaded.getBestMatch(query).dist, lazy.getBestMatch(query).dist );
+
+  std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( load_groups_lazily )
+{
+  std::string path = "test_groups_lazy.tmp";
+
+  GroupableTimeSeriesSet tsSet;
+  tsSet.loadData(data.test_10_20_space, 0, 0, " ");
+  int groupCnt = tsSet.groupAllLengths("euclidean", 0.5);
+  tsSet.saveGroups(path, false);
+
+  GroupableTimeSeriesSet lazy;
+  lazy.loadData(data.test_10_20_space, 0, 0, " ");
+  BOOST_CHECK_EQUAL( lazy.loadGroups(path), groupCnt );
+  BOOST_CHECK_EQUAL( lazy.getLoadedLengthCount(), 0 );
+
+  TimeSeries query = tsSet.getTimeSeries(2, 4, 10);
+  candidate_time_series_t expected = tsSet.getBestMatch(query);
+  candidate_time_series_t best = lazy.getBestMatch(query);
+  BOOST_CHECK_EQUAL( best.dist, expected.dist );
+  int loaded = lazy.getLoadedLengthCount();
+  BOOST_CHECK( loaded > 0 && loaded < tsSet.getItemLength() - 1 );
+
+  // With a tiny limit, only the lengths needed at the moment are kept
+  lazy.setGroupMemoryLimit(1);
+  BOOST_CHECK_EQUAL( lazy.getLoadedLengthCount(), 0 );
+  for (int i = 0; i < tsSet.getItemCount(); i++)
+  {
+    query = tsSet.getTimeSeries(i, 1, 15);
+    BOOST_CHECK_EQUAL( lazy.getBestMatch(query).dist, tsSet.getBestMatch(query).dist );
+    BOOST_CHECK( lazy.getLoadedLengthCount() <= 2 );
+  }
+
+  // Groups can be saved over the file they are being read from
+  lazy.saveGroups(path, false);
+  GroupableTimeSeriesSet reloaded;
+  reloaded.loadData(data.test_10_20_space, 0, 0, " ");
+  BOOST_CHECK_EQUAL( reloaded.loadGroups(path), groupCnt );
+
+  std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( memory_usage )
+{
+  GroupableTimeSeriesSet tsSet;
+  tsSet.loadData(data.test_10_20_space, 0, 0, " ");
+  memory_usage_t before = tsSet.getMemoryUsage();
+  BOOST_CHECK( before.dataset >= 10 * 20 * sizeof(data_t) );
+  BOOST_CHECK_EQUAL( before.groups, 0 );
+
+  // Grouping every length gives the exact number of groups
+  group_estimate_t estimate = tsSet.estimateGroups("euclidean", 0.5, tsSet.getItemLength() - 1);
+  group_estimate_t sampled = tsSet.estimateGroups("euclidean", 0.5, 3);
+  BOOST_CHECK( !tsSet.isGrouped() );
+  int groupCnt = tsSet.groupAllLengths("euclidean", 0.5);
+  BOOST_CHECK_EQUAL( estimate.groupCount, groupCnt );
+  BOOST_CHECK( sampled.groupCount > 0 );
+
+  memory_usage_t usage = tsSet.getMemoryUsage();
+  BOOST_CHECK_EQUAL( usage.dataset, before.dataset );
+  BOOST_CHECK_EQUAL( usage.keoghCache, 0 );
+  BOOST_CHECK_EQUAL( usage.lengths.size(), tsSet.getItemLength() + 1 );
+  size_t total = 0;
+  for (unsigned int i = 0; i < usage.lengths.size(); i++)
+  {
+    BOOST_CHECK_EQUAL( usage.lengths[i] > 0, i >= 2 );
+    total += usage.lengths[i];
+  }
+  BOOST_CHECK( usage.groups > total );
+  BOOST_CHECK( estimate.memoryUsage > total * 0.9 && estimate.memoryUsage < usage.groups * 1.1 );
+  BOOST_CHECK( estimate.peakMemoryUsage > estimate.memoryUsage );
+
+  // Queries cache the envelopes of the centroids they are compared with
+  tsSet.getBestMatch(tsSet.getTimeSeries(0, 2, 10));
+  usage = tsSet.getMemoryUsage();
+  BOOST_CHECK( usage.keoghCache > 0 );
+  BOOST_CHECK( usage.groups > total + usage.keoghCache );
+}
+
+BOOST_AUTO_TEST_CASE( group_with_budget )
+{
+  GroupableTimeSeriesSet tsSet;
+  tsSet.loadData(data.test_10_20_space, 0, 0, " ");
+  BOOST_CHECK_THROW( tsSet.groupAllLengthsWithBudget("euclidean", 0, 0), OnexException );
+
+  auto_group_result_t result = tsSet.groupAllLengthsWithBudget("euclidean", 300, 0);
+  BOOST_CHECK( result.predicted.groupCount <= 300 );
+  BOOST_CHECK( result.groupCount > 0 );
+  BOOST_CHECK_EQUAL( result.droppedGroupCount, 0 );
+  BOOST_CHECK_EQUAL( result.memoryUsage, tsSet.getMemoryUsage().groups );
+
+  // A smaller budget needs a larger threshold
+  auto_group_result_t smaller = tsSet.groupAllLengthsWithBudget("euclidean", 0, result.memoryUsage / 2);
+  BOOST_CHECK( smaller.predicted.threshold > result.predicted.threshold );
+  BOOST_CHECK( smaller.groupCount < result.groupCount );
+
+  // The budget cannot be met with one group per length at most
+  auto_group_result_t dropped = tsSet.groupAllLengthsWithBudget("euclidean", 1, 0, true);
+  int groupCnt = tsSet.groupAllLengths("euclidean", dropped.predicted.threshold);
+  BOOST_CHECK( dropped.groupCount > 1 );
+  BOOST_CHECK_EQUAL( dropped.groupCount + dropped.droppedGroupCount, groupCnt );
+}
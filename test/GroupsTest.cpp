@@ -53,25 +53,65 @@ BOOST_AUTO_TEST_CASE( basic_groups, *boost::unit_test::tolerance(TOLERANCE) )
 
   const TimeSeries& c = g.getCentroid();
 
-  // test initial centroid is all zeros
-  for (int i = 0; i < memberLength; i++)
-  {
-    BOOST_TEST( c[i] == 0 );
-  }
+  // test there is no initial centroid
+  BOOST_CHECK_EQUAL( c.getLength(), 0 );
+  BOOST_CHECK( g.getCentroidCoord() == std::make_pair(-1, -1) );
 
   g.addMember(0, 0);
   g.setCentroid(0, 0);
 
-  //checking if centroid is updated
+  //checking if centroid is updated and refers to the dataset
   BOOST_CHECK_EQUAL( g.getCount(), 1 );
   for (int i = 0; i < memberLength; i++)
   {
     BOOST_TEST( c[i] == data.dat_1[i] );
   }
+  BOOST_CHECK( g.getCentroidCoord() == std::make_pair(0, 0) );
+  BOOST_CHECK( &c[0] == &tsSet.getTimeSeries(0)[0] );
+
+  // a centroid set from itself keeps its values, in storage of its own
+  g.setCentroid(g.getCentroid());
+  BOOST_CHECK( g.getCentroidCoord() == std::make_pair(-1, -1) );
+  BOOST_CHECK( &c[0] != &tsSet.getTimeSeries(0)[0] );
+  for (int i = 0; i < memberLength; i++)
+  {
+    BOOST_TEST( c[i] == data.dat_1[i] );
+    BOOST_TEST( tsSet.getTimeSeries(0)[i] == data.dat_1[i] );
+  }
+  g.setCentroid(g.getCentroid());
+  for (int i = 0; i < memberLength; i++)
+  {
+    BOOST_TEST( c[i] == data.dat_1[i] );
+  }
+
+  // a computed centroid owns a copy of its values
+  TimeSeries values = tsSet.getTimeSeries(1, 2, 2 + memberLength);
+  g.setCentroid(values);
+  BOOST_CHECK( g.getCentroidCoord() == std::make_pair(-1, -1) );
+  BOOST_CHECK( &c[0] != &values[0] );
+  for (int i = 0; i < memberLength; i++)
+  {
+    BOOST_TEST( c[i] == values[i] );
+  }
 
   g.addMember(1, 0);
 
   BOOST_CHECK_EQUAL( g.getCount(), 2 );
+
+  // a mean centroid is the sum of the members divided by their count
+  TimeSeries sum(memberLength);
+  sum += tsSet.getTimeSeries(0, 0, memberLength);
+  sum += tsSet.getTimeSeries(1, 0, memberLength);
+  g.setMeanCentroid(sum, 2);
+  BOOST_CHECK( g.getCentroidCoord() == std::make_pair(-1, -1) );
+  for (int i = 0; i < memberLength; i++)
+  {
+    BOOST_TEST( c[i] == (tsSet.getTimeSeries(0)[i] + tsSet.getTimeSeries(1)[i]) / 2 );
+  }
+
+  BOOST_CHECK_EQUAL( g.getRadius(), INF );
+  g.setRadius(0.5);
+  BOOST_TEST( g.getRadius() == 0.5 );
 }
 
 BOOST_AUTO_TEST_CASE( group_get_best_match, *boost::unit_test::tolerance(TOLERANCE) )
@@ -1,11 +1,17 @@
 #define BOOST_TEST_MODULE "Test LocalLengthGroupSpace class"
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <vector>
 #include <boost/test/unit_test.hpp>
 #include "LocalLengthGroupSpace.hpp"
 #include "TimeSeriesSet.hpp"
 #include "distance/Distance.hpp"
 #include "Exception.hpp"
 #include "Group.hpp"
+#include "GroupFile.hpp"
+#include "MappedFile.hpp"
 
 #define TOLERANCE 1e-9
 
@@ -17,6 +23,32 @@ struct MockData
   std::string test_group_5_10_different_space = "datasets/test/test_group_5_10_different_space.txt";
 };
 
+/**
+ *  @brief checks that every sub-sequence of the length is in exactly one
+ *         group, within threshold / 2 of its centroid, and that each radius
+ *         is the distance to the farthest member
+ */
+void checkPartition(const LocalLengthGroupSpace& lgs, const TimeSeriesSet& dataset, int length, data_t threshold)
+{
+  int subCount = dataset.getItemLength() - length + 1;
+  std::vector<int> seen(dataset.getItemCount() * subCount, 0);
+  for (int i = 0; i < lgs.getNumberOfGroups(); i++)
+  {
+    const Group* group = lgs.getGroup(i);
+    BOOST_CHECK( group->getCount() > 0 );
+    data_t radius = 0;
+    std::vector<TimeSeries> members = group->getMembers();
+    for (unsigned int j = 0; j < members.size(); j++)
+    {
+      seen[members[j].getIndex() * subCount + members[j].getStart()]++;
+      radius = std::max(radius, pairwiseDistance(group->getCentroid(), members[j], INF));
+    }
+    BOOST_CHECK( radius <= threshold / 2 );
+    BOOST_CHECK_CLOSE( radius + 1, group->getRadius() + 1, 1e-6 );
+  }
+  BOOST_CHECK( std::count(seen.begin(), seen.end(), 1) == (int)seen.size() );
+}
+
 BOOST_AUTO_TEST_CASE( local_length_group_space, *boost::unit_test::tolerance(TOLERANCE) )
 {
   MockData data;
@@ -79,3 +111,340 @@ BOOST_AUTO_TEST_CASE( groups_best_group, *boost::unit_test::tolerance(TOLERANCE)
   BOOST_CHECK_EQUAL( groups.getGroup(1), groups.getBestGroup(tsSet.getTimeSeries(4,5,10), distance, INF).first);
   BOOST_CHECK_EQUAL( groups.getGroup(1), groups.getBestGroup(tsSet.getTimeSeries(4,6,10), distance, INF).first);
 }
+
+BOOST_AUTO_TEST_CASE( frozen_group_members )
+{
+  TimeSeriesSet tsSet;
+  tsSet.loadData("datasets/test/test_10_20_space.txt", 0, 0, " ");
+  int length = 6;
+  int subCount = tsSet.getItemLength() - length + 1;
+
+  LocalLengthGroupSpace groups(tsSet, length);
+  groups.generateGroups(pairwiseDistance, 0.5);
+
+  // Every sub-sequence is in exactly one group and members are in dataset order
+  checkPartition(groups, tsSet, length, 0.5);
+  for (int i = 0; i < groups.getNumberOfGroups(); i++)
+  {
+    const Group* group = groups.getGroup(i);
+    BOOST_CHECK( group->isFrozen() );
+    std::vector<member_coord_t> coords = group->getMemberCoords();
+    BOOST_CHECK_EQUAL( (int)coords.size(), group->getCount() );
+    for (unsigned int j = 1; j < coords.size(); j++) {
+      BOOST_CHECK( coords[j - 1] < coords[j] );
+    }
+  }
+
+  // The member map is freed, leaving 4 bytes per member
+  groups.generateGroups(pairwiseDistance, INF);
+  BOOST_CHECK_EQUAL( groups.getNumberOfGroups(), 1 );
+  BOOST_CHECK( groups.getMemoryUsage() < tsSet.getItemCount() * subCount * sizeof(group_membership_t) );
+}
+
+BOOST_AUTO_TEST_CASE( drop_singleton_groups )
+{
+  TimeSeriesSet tsSet;
+  tsSet.loadData("datasets/test/test_10_20_space.txt", 0, 0, " ");
+
+  // Some groups of this threshold have a single member, and some do not
+  LocalLengthGroupSpace groups(tsSet, 6);
+  int groupCnt = groups.generateGroups(pairwiseDistance, 2);
+  int singletons = 0;
+  int members = 0;
+  for (int i = 0; i < groupCnt; i++)
+  {
+    singletons += groups.getGroup(i)->getCount() == 1;
+    members += groups.getGroup(i)->getCount();
+  }
+  BOOST_REQUIRE( singletons > 0 );
+
+  BOOST_CHECK_EQUAL( groups.dropSingletonGroups(), singletons );
+  BOOST_CHECK_EQUAL( groups.getNumberOfGroups(), groupCnt - singletons );
+  int remaining = 0;
+  for (int i = 0; i < groups.getNumberOfGroups(); i++)
+  {
+    BOOST_CHECK( groups.getGroup(i)->getCount() > 1 );
+    BOOST_CHECK_EQUAL( groups.getGroup(i)->getIndex(), i );
+    remaining += groups.getGroup(i)->getMemberCoords().size();
+  }
+  BOOST_CHECK_EQUAL( remaining, members - singletons );
+}
+
+/**
+ *  @brief loads a section of a binary group file with two groups of
+ *         uncompressed members
+ */
+int loadMembers(LocalLengthGroupSpace& lgs, int length, const std::vector<uint32_t>& members, int firstCount)
+{
+  std::string path = "test_group_section.tmp";
+  {
+    std::ofstream fout(path, std::ios::binary);
+    group_length_header_t header = { 2, members.size() };
+    fout.write((const char*)&header, sizeof(header));
+    std::vector<data_t> centroids(2 * length, 0);
+    fout.write((const char*)centroids.data(), centroids.size() * sizeof(data_t));
+    uint64_t memberOffsets[3] = { 0, (uint64_t)firstCount, members.size() };
+    fout.write((const char*)memberOffsets, sizeof(memberOffsets));
+    fout.write((const char*)members.data(), members.size() * sizeof(uint32_t));
+  }
+  group_file_header_t fileHeader = {};
+  fileHeader.valueSize = sizeof(data_t);
+  try
+  {
+    MappedFile file(path);
+    int groupCount = lgs.loadGroupsBinary(file, 0, fileHeader);
+    std::remove(path.c_str());
+    return groupCount;
+  }
+  catch (const OnexException&)
+  {
+    std::remove(path.c_str());
+    throw;
+  }
+}
+
+BOOST_AUTO_TEST_CASE( load_corrupted_members )
+{
+  TimeSeriesSet tsSet;
+  tsSet.loadData("datasets/test/test_10_20_space.txt", 0, 0, " ");
+  int length = 5;
+  uint32_t subsequenceCount = tsSet.getItemCount() * (tsSet.getItemLength() - length + 1);
+
+  LocalLengthGroupSpace lgs(tsSet, length);
+  BOOST_CHECK_EQUAL( loadMembers(lgs, length, { 3, 1, 7 }, 2), 2 );
+  BOOST_CHECK_EQUAL( lgs.getGroup(0)->getCount(), 2 );
+
+  // A sub-sequence in two groups, twice in a group, or out of range
+  BOOST_CHECK_THROW( loadMembers(lgs, length, { 1, 3, 3 }, 2), OnexException );
+  BOOST_CHECK_THROW( loadMembers(lgs, length, { 3, 3, 7 }, 2), OnexException );
+  BOOST_CHECK_THROW( loadMembers(lgs, length, { 1, 3, subsequenceCount }, 2), OnexException );
+}
+
+BOOST_AUTO_TEST_CASE( two_phase_grouping )
+{
+  TimeSeriesSet tsSet;
+  tsSet.loadData("datasets/test/test_10_20_space.txt", 0, 0, " ");
+  int length = 5;
+  data_t threshold = 0.3;
+
+  LocalLengthGroupSpace sequential(tsSet, length);
+  LocalLengthGroupSpace groups(tsSet, length);
+  int sequentialCnt = sequential.generateGroups(pairwiseDistance, threshold);
+  int groupCnt = groups.generateGroups(pairwiseDistance, threshold, 3);
+  BOOST_CHECK( groupCnt > 0 );
+  BOOST_CHECK( groupCnt < 2 * sequentialCnt );
+
+  // Every sub-sequence is in one group, within threshold / 2 of its centroid
+  checkPartition(groups, tsSet, length, threshold);
+  for (int i = 0; i < groupCnt; i++) {
+    BOOST_CHECK( groups.getGroup(i)->getCentroidCoord().first >= 0 );
+  }
+}
+
+BOOST_AUTO_TEST_CASE( ordered_grouping )
+{
+  TimeSeriesSet tsSet;
+  tsSet.loadData("datasets/test/test_10_20_space.txt", 0, 0, " ");
+  int length = 6;
+  data_t threshold = 0.3;
+
+  group_order_t orders[] = { GROUP_ORDER_START, GROUP_ORDER_MEAN, GROUP_ORDER_PAA };
+  for (group_order_t order : orders)
+  {
+    for (bool meanCentroids : { false, true })
+    {
+      LocalLengthGroupSpace groups(tsSet, length);
+      int groupCnt = groups.generateGroups(pairwiseDistance, threshold, order, meanCentroids);
+      BOOST_CHECK( groupCnt > 0 );
+
+      // Every sub-sequence is in one group, within threshold / 2 of its centroid
+      checkPartition(groups, tsSet, length, threshold);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( refine_groups )
+{
+  TimeSeriesSet tsSet;
+  tsSet.loadData("datasets/test/test_10_20_space.txt", 0, 0, " ");
+  int length = 6;
+  int subCount = tsSet.getItemLength() - length + 1;
+  data_t threshold = 0.3;
+
+  LocalLengthGroupSpace groups(tsSet, length);
+  int before = groups.generateGroups(pairwiseDistance, threshold);
+  bool hasMeanCentroids;
+  int groupCnt = groups.refineGroups(pairwiseDistance, threshold, 5, 3, 2, hasMeanCentroids);
+  BOOST_CHECK( groupCnt > 0 );
+  BOOST_CHECK( groupCnt <= before );
+  BOOST_CHECK_EQUAL( groupCnt, groups.getNumberOfGroups() );
+  bool anyMean = false;
+  for (int i = 0; i < groupCnt; i++) {
+    anyMean = anyMean || groups.getGroup(i)->getCentroidCoord().first < 0;
+  }
+  BOOST_CHECK_EQUAL( hasMeanCentroids, anyMean );
+
+  // Every sub-sequence is still in one group, within threshold / 2 of its centroid
+  checkPartition(groups, tsSet, length, threshold);
+
+  // Sub-sequences of dropped groups stay out of the groups
+  int dropped = groups.dropSingletonGroups();
+  int ungrouped = tsSet.getItemCount() * subCount;
+  for (int i = 0; i < groups.getNumberOfGroups(); i++) {
+    ungrouped -= groups.getGroup(i)->getCount();
+  }
+  groups.refineGroups(pairwiseDistance, threshold, 2, 1, 1, hasMeanCentroids);
+  int count = 0;
+  for (int i = 0; i < groups.getNumberOfGroups(); i++) {
+    count += groups.getGroup(i)->getCount();
+  }
+  BOOST_CHECK_EQUAL( count, tsSet.getItemCount() * subCount - ungrouped );
+  BOOST_CHECK_EQUAL( ungrouped, dropped );
+}
+
+BOOST_AUTO_TEST_CASE( best_match_by_metric )
+{
+  TimeSeriesSet tsSet;
+  tsSet.loadData("datasets/test/test_10_20_space.txt", 0, 0, " ");
+  int length = 7;
+  int subCount = tsSet.getItemLength() - length + 1;
+
+  LocalLengthGroupSpace groups(tsSet, length);
+  groups.generateGroups(pairwiseDistance, 0.4);
+  BOOST_CHECK_THROW( groups.getBestMatchByMetric(tsSet.getTimeSeries(0, 0, 5), pairwiseDistance, INF),
+                     OnexException );
+
+  // The pruned search finds the same distance as comparing every sub-sequence
+  for (int q = 0; q < tsSet.getItemCount(); q++)
+  {
+    TimeSeries query(length);
+    for (int k = 0; k < length; k++) {
+      query[k] = (tsSet.getTimeSeries(q)[k + 3] + tsSet.getTimeSeries((q + 1) % 10)[k]) / 2;
+    }
+    data_t expected = INF;
+    for (int i = 0; i < tsSet.getItemCount(); i++) {
+      for (int start = 0; start < subCount; start++) {
+        expected = std::min(expected, pairwiseDistance(query, tsSet.getTimeSeries(i, start, start + length), INF));
+      }
+    }
+    candidate_time_series_t best = groups.getBestMatchByMetric(query, pairwiseDistance, INF);
+    BOOST_CHECK_CLOSE( best.dist + 1, expected + 1, 1e-6 );
+    BOOST_CHECK_CLOSE( pairwiseDistance(query, best.data, INF) + 1, expected + 1, 1e-6 );
+
+    // Nothing is returned when no sub-sequence is closer than the dropout
+    BOOST_CHECK_EQUAL( groups.getBestMatchByMetric(query, pairwiseDistance, expected * 0.99).data.getLength(), 0 );
+  }
+
+  // Members are now sorted by their distance to the centroid
+  for (int i = 0; i < groups.getNumberOfGroups(); i++)
+  {
+    const Group* group = groups.getGroup(i);
+    std::vector<TimeSeries> members = group->getMembers();
+    for (unsigned int j = 1; j < members.size(); j++)
+    {
+      BOOST_CHECK( pairwiseDistance(group->getCentroid(), members[j - 1], INF) <=
+                   pairwiseDistance(group->getCentroid(), members[j], INF) );
+    }
+    BOOST_CHECK_EQUAL( group->getRadius(), pairwiseDistance(group->getCentroid(), members.back(), INF) );
+  }
+}
+
+BOOST_AUTO_TEST_CASE( super_group_search )
+{
+  TimeSeriesSet tsSet;
+  tsSet.loadData("datasets/test/test_10_20_space.txt", 0, 0, " ");
+  int length = 5;
+  int subCount = tsSet.getItemLength() - length + 1;
+
+  // A small threshold makes enough groups for several levels of super-groups
+  LocalLengthGroupSpace groups(tsSet, length);
+  groups.generateGroups(pairwiseDistance, 0.05);
+  BOOST_CHECK( groups.getNumberOfGroups() > 16 );
+  BOOST_CHECK_EQUAL( groups.getNumberOfSuperGroups(), 0 );
+
+  for (int q = 0; q < tsSet.getItemCount(); q++)
+  {
+    TimeSeries query(length);
+    for (int k = 0; k < length; k++) {
+      query[k] = (tsSet.getTimeSeries(q)[k + 7] * 2 + tsSet.getTimeSeries((q + 3) % 10)[k]) / 3;
+    }
+    data_t expected = INF;
+    for (int i = 0; i < tsSet.getItemCount(); i++) {
+      for (int start = 0; start < subCount; start++) {
+        expected = std::min(expected, pairwiseDistance(query, tsSet.getTimeSeries(i, start, start + length), INF));
+      }
+    }
+    candidate_time_series_t best = groups.getBestMatchByMetric(query, pairwiseDistance, INF);
+    BOOST_CHECK_CLOSE( best.dist + 1, expected + 1, 1e-6 );
+  }
+  BOOST_CHECK( groups.getNumberOfSuperGroups() > 1 );
+
+  // Regrouping drops the super-groups
+  groups.dropSingletonGroups();
+  BOOST_CHECK_EQUAL( groups.getNumberOfSuperGroups(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( super_group_best_group )
+{
+  TimeSeriesSet tsSet;
+  tsSet.loadData("datasets/test/test_10_20_space.txt", 0, 0, " ");
+  int length = 5;
+
+  LocalLengthGroupSpace groups(tsSet, length);
+  groups.generateGroups(pairwiseDistance, 0.05);
+  std::vector<candidate_group_t> flat;
+  std::vector<TimeSeries> queries;
+  for (int q = 0; q < tsSet.getItemCount(); q++)
+  {
+    // Queries of other lengths are compared with warped distances
+    TimeSeries query(length - 1 + q % 3);
+    for (int k = 0; k < query.getLength(); k++) {
+      query[k] = (tsSet.getTimeSeries(q)[k + 7] * 2 + tsSet.getTimeSeries((q + 3) % 10)[k]) / 3;
+    }
+    flat.push_back(groups.getBestGroup(query, warpedDistance, INF));
+    queries.push_back(query);
+  }
+
+  groups.buildSuperGroups(pairwiseDistance);
+  BOOST_CHECK( groups.getNumberOfSuperGroups() > 1 );
+  for (unsigned int q = 0; q < queries.size(); q++)
+  {
+    candidate_group_t hierarchical = groups.getBestGroup(queries[q], warpedDistance, INF);
+    BOOST_CHECK_EQUAL( hierarchical.first, flat[q].first );
+    BOOST_CHECK_EQUAL( hierarchical.second, flat[q].second );
+  }
+}
+
+BOOST_AUTO_TEST_CASE( length_lower_bound )
+{
+  TimeSeriesSet tsSet;
+  tsSet.loadData("datasets/test/test_10_20_space.txt", 0, 0, " ");
+  int length = 8;
+
+  LocalLengthGroupSpace groups(tsSet, length);
+  BOOST_CHECK_EQUAL( groups.getLowerBound(tsSet.getTimeSeries(0, 0, length)), INF );
+  groups.generateGroups(pairwiseDistance, 0.3);
+
+  // The bound holds for every centroid and queries of nearby lengths
+  for (int queryLength = length - 1; queryLength <= length + 1; queryLength++)
+  {
+    for (int q = 0; q < tsSet.getItemCount(); q++)
+    {
+      TimeSeries query(queryLength);
+      for (int k = 0; k < queryLength; k++) {
+        query[k] = tsSet.getTimeSeries(q)[k + 2] * (1 + q % 3);
+      }
+      data_t bound = groups.getLowerBound(query);
+      for (int i = 0; i < groups.getNumberOfGroups(); i++) {
+        BOOST_CHECK( bound <= warpedDistance(groups.getGroup(i)->getCentroid(), query, INF) );
+      }
+    }
+  }
+
+  // A query far above every centroid gets a positive bound
+  TimeSeries query(length);
+  for (int k = 0; k < length; k++) {
+    query[k] = 100;
+  }
+  BOOST_CHECK( groups.getLowerBound(query) > 0 );
+}
@@ -1,7 +1,11 @@
 #define BOOST_TEST_MODULE "Test TimeSeriesSet class"
 
 #include <boost/test/unit_test.hpp>
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
 
 #include "TimeSeriesSet.hpp"
 #include "Exception.hpp"
@@ -24,6 +28,9 @@ struct MockDataset
   std::string test_5_10_space = "datasets/test/test_5_10_space.txt";
   std::string test_3_10_space = "datasets/test/test_3_10_space.txt";
   std::string test_3_11_space = "datasets/test/test_3_11_space.txt";
+  std::string test_3_4_mixed = "datasets/test/test_3_4_mixed_separators.txt";
+  std::string test_3_4_double_npy = "datasets/test/test_3_4_double.npy";
+  std::string test_3_4_float_npy = "datasets/test/test_3_4_float.npy";
 } data;
 
 BOOST_AUTO_TEST_CASE( time_series_set_load_space, *boost::unit_test::tolerance(TOLERANCE) )
@@ -58,6 +65,159 @@ BOOST_AUTO_TEST_CASE( time_series_set_load_comma, *boost::unit_test::tolerance(T
   BOOST_TEST( ts[ts.getLength() - 1] == 2.684802835);
 }
 
+BOOST_AUTO_TEST_CASE( time_series_set_load_mixed_separators, *boost::unit_test::tolerance(TOLERANCE) )
+{
+  TimeSeriesSet tsSet;
+  tsSet.loadData(data.test_3_4_mixed, 0, 0, "; ");
+
+  BOOST_CHECK_EQUAL( tsSet.getItemLength(), 4 );
+  BOOST_CHECK_EQUAL( tsSet.getItemCount(), 3 );
+
+  TimeSeries ts = tsSet.getTimeSeries(0);
+  BOOST_TEST( ts[0] == 1.5 );
+  BOOST_TEST( ts[1] == 20.0 );
+  BOOST_TEST( ts[2] == -3.25 );
+  BOOST_TEST( ts[3] == 4.0 );
+
+  ts = tsSet.getTimeSeries(1);
+  BOOST_TEST( ts[1] == 0.6 );
+  BOOST_TEST( ts[2] == 7.0 );
+  BOOST_TEST( ts[3] == 8.0 );
+
+  tsSet.loadData(data.test_3_4_mixed, 2, 3, ";");
+  BOOST_CHECK_EQUAL( tsSet.getItemLength(), 1 );
+  BOOST_CHECK_EQUAL( tsSet.getItemCount(), 2 );
+  BOOST_TEST( tsSet.getTimeSeries(1)[0] == 8.0 );
+}
+
+BOOST_AUTO_TEST_CASE( time_series_set_load_parallel )
+{
+  // Large enough to be split into several chunks
+  std::string path = "test_load_parallel.tmp";
+  int rows = 40000;
+  int length = 32;
+  {
+    std::ofstream f(path);
+    for (int i = 0; i < rows; i++)
+    {
+      for (int j = 0; j < length; j++) {
+        f << (i * 0.25 + j * 1e-3) << (j + 1 < length ? ", " : "\n");
+      }
+    }
+  }
+
+  TimeSeriesSet serial;
+  TimeSeriesSet parallel;
+  serial.loadData(path, 0, 0, ", ", 1);
+  parallel.loadData(path, 0, 0, ", ", 4);
+  BOOST_CHECK_EQUAL( parallel.getItemCount(), rows );
+  BOOST_CHECK_EQUAL( parallel.getItemLength(), length );
+  for (int i = 0; i < rows; i++)
+  {
+    TimeSeries a = serial.getTimeSeries(i);
+    TimeSeries b = parallel.getTimeSeries(i);
+    BOOST_REQUIRE( std::equal(a.getData(), a.getData() + length, b.getData()) );
+  }
+
+  parallel.loadData(path, 12345, 0, ", ", 4);
+  BOOST_CHECK_EQUAL( parallel.getItemCount(), 12345 );
+  BOOST_CHECK( parallel.getTimeSeries(12344)[0] == serial.getTimeSeries(12344)[0] );
+
+  // A bad row near the end of the file is still reported
+  {
+    std::ofstream f(path, std::ios::app);
+    f << "1, 2, 3\n";
+  }
+  BOOST_CHECK_THROW( parallel.loadData(path, 0, 0, ", ", 4), OnexException );
+  BOOST_CHECK_EQUAL( parallel.getItemCount(), 0 );
+
+  std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( time_series_set_save_load_text )
+{
+  std::string path = "test_save_text.tmp";
+  TimeSeriesSet tsSet;
+  tsSet.loadData(data.test_10_20_space, 0, 0, " ");
+  tsSet.normalize();
+  tsSet.saveData(path, ',');
+
+  TimeSeriesSet loaded;
+  loaded.loadData(path, 0, 0, ",");
+  BOOST_CHECK_EQUAL( loaded.getItemCount(), 10 );
+  BOOST_CHECK_EQUAL( loaded.getItemLength(), 20 );
+  for (int i = 0; i < 10; i++)
+  {
+    TimeSeries a = tsSet.getTimeSeries(i);
+    TimeSeries b = loaded.getTimeSeries(i);
+    BOOST_CHECK( std::equal(a.getData(), a.getData() + 20, b.getData()) );
+  }
+  std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( time_series_set_save_load_binary )
+{
+  std::string path = "test_save_binary.tmp";
+  TimeSeriesSet tsSet;
+  tsSet.loadData(data.test_10_20_space, 0, 0, " ");
+  std::pair<data_t, data_t> range = tsSet.normalize();
+  tsSet.saveBinaryData(path);
+
+  TimeSeriesSet loaded;
+  loaded.loadData(path, 0, 0, " ");
+  BOOST_CHECK_EQUAL( loaded.getItemCount(), 10 );
+  BOOST_CHECK_EQUAL( loaded.getItemLength(), 20 );
+  BOOST_CHECK( loaded.isNormalized() );
+  BOOST_CHECK( loaded.getNormalizationRange() == range );
+  for (int i = 0; i < 10; i++)
+  {
+    TimeSeries a = tsSet.getTimeSeries(i);
+    TimeSeries b = loaded.getTimeSeries(i);
+    BOOST_CHECK( std::equal(a.getData(), a.getData() + 20, b.getData()) );
+  }
+
+  // Mapped values can still be changed in memory
+  loaded.PAA(2);
+  BOOST_CHECK_EQUAL( loaded.getItemLength(), 10 );
+
+  loaded.loadBinaryData(path, 4);
+  BOOST_CHECK_EQUAL( loaded.getItemCount(), 4 );
+  BOOST_CHECK_THROW( loaded.loadData(path, 0, 1, " "), OnexException );
+  BOOST_CHECK_THROW( loaded.loadBinaryData(data.test_10_20_space), OnexException );
+
+  // A header that promises more values than the file has
+  TimeSeriesSet().saveBinaryData(path);
+  std::ifstream in(path, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  in.close();
+  bytes[16] = 5; // itemCount
+  bytes[24] = 5; // itemLength
+  std::ofstream(path, std::ios::binary) << bytes;
+  BOOST_CHECK_THROW( loaded.loadBinaryData(path), OnexException );
+
+  std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( time_series_set_load_npy, *boost::unit_test::tolerance(1e-6) )
+{
+  TimeSeriesSet tsSet;
+  std::string files[] = { data.test_3_4_double_npy, data.test_3_4_float_npy };
+  for (const std::string& file : files)
+  {
+    tsSet.loadData(file, 0, 0, " ");
+    BOOST_CHECK_EQUAL( tsSet.getItemCount(), 3 );
+    BOOST_CHECK_EQUAL( tsSet.getItemLength(), 4 );
+    BOOST_CHECK( !tsSet.isNormalized() );
+    BOOST_TEST( tsSet.getTimeSeries(0)[1] == 20.0 );
+    BOOST_TEST( tsSet.getTimeSeries(1)[1] == 0.6 );
+    BOOST_TEST( tsSet.getTimeSeries(2)[3] == 9.75 );
+  }
+
+  tsSet.loadNpyData(data.test_3_4_double_npy, 2);
+  BOOST_CHECK_EQUAL( tsSet.getItemCount(), 2 );
+  BOOST_CHECK_THROW( tsSet.loadNpyData(data.test_3_4_mixed), OnexException );
+}
+
 BOOST_AUTO_TEST_CASE( time_series_set_load_file_not_exist )
 {
   TimeSeriesSet tsSet;
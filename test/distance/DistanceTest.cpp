@@ -124,4 +124,146 @@ BOOST_AUTO_TEST_CASE( keogh_lower_bound, *boost::unit_test::tolerance(TOLERANCE)
   data_t klb = keoghLowerBound(a, b, 10);
 
   BOOST_TEST( klb == sqrt(31.0) / (2 * 10) );
-}
\ No newline at end of file
+}
+BOOST_AUTO_TEST_CASE( warped_distance_prefixes, *boost::unit_test::tolerance(TOLERANCE) )
+{
+  data_t query[12], data[20];
+  for (int i = 0; i < 12; i++) {
+    query[i] = sin(i * 0.7);
+  }
+  for (int i = 0; i < 20; i++) {
+    data[i] = cos(i * 0.4) + (i % 3) * 0.1;
+  }
+  TimeSeries a{query, 12};
+  TimeSeries b{data, 0, 2, 20};
+
+  vector<int> lengths;
+  for (int length = 1; length <= 18; length++) {
+    lengths.push_back(length);
+  }
+
+  double ratios[] = {0.0, 0.1, 0.25, 0.5, 1.0};
+  for (double ratio : ratios)
+  {
+    setWarpingBandRatio(ratio);
+    vector<data_t> prefixes = warpedDistancePrefixes(a, b, lengths, INF);
+    for (unsigned int k = 0; k < lengths.size(); k++)
+    {
+      TimeSeries prefix{data, 0, 2, 2 + lengths[k]};
+      data_t expected = warpedDistance(a, prefix, INF);
+      if (expected == INF) {
+        BOOST_TEST( prefixes[k] == INF );
+      }
+      else {
+        BOOST_TEST_INFO( "ratio " << ratio << " length " << lengths[k] );
+        BOOST_TEST( prefixes[k] == expected );
+      }
+    }
+  }
+  setWarpingBandRatio(0.1);
+}
+
+BOOST_AUTO_TEST_CASE( warped_distance_batch, *boost::unit_test::tolerance(TOLERANCE) )
+{
+  data_t query[9], data[30];
+  for (int i = 0; i < 9; i++) {
+    query[i] = sin(i * 0.9);
+  }
+  for (int i = 0; i < 30; i++) {
+    data[i] = cos(i * 0.3) * (1 + (i % 4) * 0.2);
+  }
+  TimeSeries a{query, 9};
+
+  // More candidates than lanes, so the last batch is not full
+  vector<TimeSeries> candidates;
+  for (int start = 0; start < 11; start++) {
+    candidates.push_back(TimeSeries(data, 0, start, start + 12));
+  }
+  vector<const TimeSeries*> pointers;
+  for (const TimeSeries& candidate : candidates) {
+    pointers.push_back(&candidate);
+  }
+
+  setWarpingBandRatio(0.3);
+  vector<data_t> distances = warpedDistanceBatch(a, pointers, INF);
+  data_t best = INF;
+  for (unsigned int k = 0; k < candidates.size(); k++)
+  {
+    BOOST_TEST( distances[k] == warpedDistance(a, candidates[k], INF) );
+    best = min(best, distances[k]);
+  }
+
+  // Only candidates that are not closer than the dropout can be abandoned
+  vector<data_t> cascaded = cascadeDistanceBatch(a, pointers, best * 1.1);
+  for (unsigned int k = 0; k < candidates.size(); k++)
+  {
+    if (distances[k] < best * 1.1) {
+      BOOST_TEST( cascaded[k] == distances[k] );
+    }
+    else {
+      BOOST_TEST( (cascaded[k] == INF || cascaded[k] == distances[k]) );
+    }
+  }
+  setWarpingBandRatio(0.1);
+}
+
+BOOST_AUTO_TEST_CASE( long_warped_distance, *boost::unit_test::tolerance(TOLERANCE) )
+{
+  // Long enough for the kernel that computes by anti-diagonals
+  data_t x[600], y[600];
+  for (int i = 0; i < 600; i++)
+  {
+    x[i] = sin(i * 0.05) + cos(i * 0.31);
+    y[i] = sin(i * 0.05 + 0.4) + (i % 7) * 0.05;
+  }
+  TimeSeries a{x, 0, 0, 600};
+  int lengths[] = {540, 570, 600};
+
+  double ratios[] = {0.0, 0.05, 0.1, 0.5};
+  for (double ratio : ratios)
+  {
+    setWarpingBandRatio(ratio);
+    for (int length : lengths)
+    {
+      TimeSeries b{y, 0, 0, length};
+      data_t expected = warpedDistancePrefixes(a, b, vector<int>(1, length), INF)[0];
+      data_t actual = warpedDistance(a, b, INF);
+      if (expected == INF) {
+        BOOST_TEST( actual == INF );
+      }
+      else {
+        BOOST_TEST( actual == expected );
+        BOOST_TEST( warpedDistance(a, b, expected / 2) >= expected / 2 );
+      }
+    }
+  }
+  setWarpingBandRatio(0.1);
+}
+
+BOOST_AUTO_TEST_CASE( improved_lower_bound, *boost::unit_test::tolerance(TOLERANCE) )
+{
+  MockData data;
+  TimeSeries a{data.dat_13, 10};
+  TimeSeries b{data.dat_14, 7};
+  TimeSeries c{data.dat_13, 0, 2, 9};
+
+  setWarpingBandRatio(0.2);
+  data_t dtw = warpedDistance(a, b, INF);
+  data_t klb = keoghLowerBound(a, b, INF);
+  data_t ilb = improvedLowerBound(a, b, INF);
+  BOOST_TEST( klb <= ilb );
+  BOOST_TEST( ilb <= dtw );
+  BOOST_TEST( improvedLowerBound(b, a, INF) <= dtw );
+  BOOST_TEST( improvedLowerBound(c, b, INF) <= warpedDistance(c, b, INF) );
+
+  // Each pair is counted by the stage that stopped it
+  resetCascadeStats();
+  BOOST_TEST( cascadeDistance(a, b, INF) == dtw );
+  BOOST_TEST( cascadeDistance(a, b, klb / 2) == INF );
+  cascade_stats_t stats = getCascadeStats();
+  BOOST_TEST( stats.candidates == 2u );
+  BOOST_TEST( stats.keoghPruned == 1u );
+  BOOST_TEST( stats.improvedPruned == 0u );
+  BOOST_TEST( stats.warped == 1u );
+  setWarpingBandRatio(0.1);
+}
@@ -0,0 +1,111 @@
+#define BOOST_TEST_MODULE "Test MASS distance profile"
+
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <vector>
+
+#include "distance/Distance.hpp"
+#include "distance/FFT.hpp"
+#include "distance/MASS.hpp"
+#include "TimeSeriesSet.hpp"
+#include "Exception.hpp"
+
+#define TOLERANCE 1e-9
+
+using namespace onex;
+
+struct MockData
+{
+  data_t dat_1[10] = {0, 2, 3, 5, 8, 6, 3, 2, 3, 5};
+  data_t dat_2[10] = {1, 1, 2, 2, 3, 3, 4, 4, 5, 5};
+  data_t query[4]  = {3, 5, 8, 6};
+
+  std::string test_10_20_space = "datasets/test/test_10_20_space.txt";
+  std::string test_3_10_space = "datasets/test/test_3_10_space.txt";
+};
+
+BOOST_AUTO_TEST_CASE( fft_round_trip, *boost::unit_test::tolerance(TOLERANCE) )
+{
+  FFT fft(8);
+  std::vector<complex_t> a(8), b(8);
+  for (int i = 0; i < 8; i++) {
+    a[i] = b[i] = complex_t(i * i - 3, 1 - i);
+  }
+  fft.transform(b, false);
+  fft.transform(b, true);
+  for (int i = 0; i < 8; i++)
+  {
+    BOOST_TEST( b[i].real() == a[i].real() );
+    BOOST_TEST( b[i].imag() == a[i].imag() );
+  }
+  BOOST_CHECK_THROW( FFT(6), OnexException );
+  BOOST_CHECK_EQUAL( FFT::nextPowerOfTwo(9), 16 );
+}
+
+BOOST_AUTO_TEST_CASE( mass_distance_profile, *boost::unit_test::tolerance(1e-6) )
+{
+  MockData data;
+  TimeSeries query(data.query, 4);
+  MASS mass(query, 10);
+  BOOST_CHECK_EQUAL( mass.getProfileLength(), 7 );
+
+  std::vector<data_t> profile1, profile2;
+  mass.distanceProfile(data.dat_1, data.dat_2, profile1, profile2);
+  for (int i = 0; i < mass.getProfileLength(); i++)
+  {
+    TimeSeries t1(data.dat_1, 0, i, i + 4);
+    TimeSeries t2(data.dat_2, 1, i, i + 4);
+    BOOST_TEST( profile1[i] == pairwiseDistance(t1, query, INF) );
+    BOOST_TEST( profile2[i] == pairwiseDistance(t2, query, INF) );
+  }
+  BOOST_TEST( profile1[2] == 0.0 );
+}
+
+BOOST_AUTO_TEST_CASE( mass_query_too_long )
+{
+  MockData data;
+  TimeSeries query(data.dat_1, 10);
+  BOOST_CHECK_THROW( MASS(query, 9), OnexException );
+}
+
+BOOST_AUTO_TEST_CASE( brute_force_best_match, *boost::unit_test::tolerance(TOLERANCE) )
+{
+  MockData data;
+  TimeSeriesSet tsSet;
+  tsSet.loadData(data.test_10_20_space, 0, 0, " ");
+
+  candidate_time_series_t best = tsSet.getBestMatchBruteForce(tsSet.getTimeSeries(7, 3, 15));
+  BOOST_CHECK_EQUAL( best.data.getIndex(), 7 );
+  BOOST_CHECK_EQUAL( best.data.getStart(), 3 );
+  BOOST_CHECK_EQUAL( best.data.getLength(), 12 );
+  BOOST_TEST( best.dist == 0.0 );
+
+  data_t q[5] = {2.5, 2.5, 2.5, 2.5, 2.5};
+  TimeSeries query(q, 5);
+  best = tsSet.getBestMatchBruteForce(query);
+  data_t expected = INF;
+  for (int idx = 0; idx < tsSet.getItemCount(); idx++)
+  {
+    for (int start = 0; start + 5 <= tsSet.getItemLength(); start++)
+    {
+      expected = std::min(expected, pairwiseDistance(tsSet.getTimeSeries(idx, start, start + 5), query, INF));
+    }
+  }
+  BOOST_TEST( best.dist == expected );
+}
+
+BOOST_AUTO_TEST_CASE( range_query, *boost::unit_test::tolerance(TOLERANCE) )
+{
+  MockData data;
+  TimeSeriesSet tsSet;
+  tsSet.loadData(data.test_3_10_space, 0, 0, " ");
+
+  std::vector<candidate_time_series_t> matches = tsSet.getMatchesWithin(tsSet.getTimeSeries(0, 0, 9), 0.0);
+  BOOST_CHECK_EQUAL( matches.size(), 2 );
+  BOOST_CHECK_EQUAL( matches[0].data.getIndex(), 0 );
+  BOOST_CHECK_EQUAL( matches[1].data.getIndex(), 1 );
+
+  matches = tsSet.getMatchesWithin(tsSet.getTimeSeries(0), 1.0);
+  BOOST_CHECK_EQUAL( matches.size(), 2 );
+  BOOST_TEST( matches[1].dist == sqrt(1.0 / 10.0) );
+}